@@ -16,6 +16,7 @@
 #define ERR_MODE 4
 #define ROTATION_SPEED 0.05f
 #define OUTPUT_FILE "montecarlo.txt"
+#define NUM_POINTS_PER_FRAME 256
 
 ////////////////////////////////////////
 /// Exit the game loop if the user
@@ -78,39 +79,46 @@ int main(int argc, char** argv)
 
     int numInsidePoints = 0;
     int numOutsidePoints = 0;
+
+    // points are generated and drawn in batches
+    TXvec4 positions[NUM_POINTS_PER_FRAME];
+    TXvec4 colors[NUM_POINTS_PER_FRAME];
+
     while (!processInput()) {
 
         // note the absence of txClear
 
-        long rand_x = random() % 1000;
-        long rand_y = random() % 1000;
+        for (int i = 0; i < NUM_POINTS_PER_FRAME; ++i) {
+            long rand_x = random() % 1000;
+            long rand_y = random() % 1000;
 
-        float pos_x = (float)rand_x / 1000.0f;
-        float pos_y = (float)rand_y / 1000.0f;
+            float pos_x = (float)rand_x / 1000.0f;
+            float pos_y = (float)rand_y / 1000.0f;
 
-        pos_x = 1.0f - pos_x * 2.0f;
-        pos_y = 1.0f - pos_y * 2.0f;
+            pos_x = 1.0f - pos_x * 2.0f;
+            pos_y = 1.0f - pos_y * 2.0f;
 
-        TXvec4 pos = { pos_x, pos_y, 0.0f, 1.0f };
+            txVec4Set(positions[i], pos_x, pos_y, 0.0f, 1.0f);
 
-        long rand_r = random() % 10;
-        long rand_g = random() % 10;
-        long rand_b = random() % 10;
+            long rand_r = random() % 10;
+            long rand_g = random() % 10;
+            long rand_b = random() % 10;
 
-        float col_r = (float)rand_r / 10.0f;
-        float col_g = (float)rand_g / 10.0f;
-        float col_b = (float)rand_b / 10.0f;
+            float col_r = (float)rand_r / 10.0f;
+            float col_g = (float)rand_g / 10.0f;
+            float col_b = (float)rand_b / 10.0f;
 
-        if (txVec3Len(pos) <= 1.0f) {
-            txColor3f(0.0f, col_g, col_b);
-            ++numInsidePoints;
-        }
-        else {
-            txColor3f(col_r, col_g, 0.0f);
-            ++numOutsidePoints;
+            if (txVec3Len(positions[i]) <= 1.0f) {
+                txVec4Set(colors[i], 0.0f, col_g, col_b, 1.0f);
+                ++numInsidePoints;
+            }
+            else {
+                txVec4Set(colors[i], col_r, col_g, 0.0f, 1.0f);
+                ++numOutsidePoints;
+            }
         }
 
-        txDrawPoint(pos);
+        txDrawPoints(positions, NUM_POINTS_PER_FRAME, colors[0], 0);
         txSwapBuffers();
     }
 
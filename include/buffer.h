@@ -0,0 +1,124 @@
+// Copyright (C) 2023 saccharineboi
+
+#pragma once
+
+////////////////////////////////////////
+#ifdef __cplusplus
+extern "C" {
+#endif
+////////////////////////////////////////
+
+#include "vec.h"
+#include "common.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////
+/// Returns the number of attributes, position
+/// included, each vertex of the given VAO
+/// configuration has, or 0 if vertexInfo
+/// is invalid
+////////////////////////////////////////
+TX_FORCE_INLINE int txGetNumVertexAttributes(enum TXvertexInfo vertexInfo)
+{
+    switch (vertexInfo) {
+        case TX_POSITION:
+            return 1;
+        case TX_POSITION_COLOR:
+        case TX_POSITION_NORMAL:
+        case TX_POSITION_TEXCOORD:
+            return 2;
+        case TX_POSITION_COLOR_NORMAL:
+        case TX_POSITION_COLOR_TEXCOORD:
+        case TX_POSITION_NORMAL_TEXCOORD:
+            return 3;
+        case TX_POSITION_COLOR_NORMAL_TEXCOORD:
+            return 4;
+    }
+    return 0;
+}
+
+////////////////////////////////////////
+/// Vertex buffer object
+///
+/// Owns a copy of the vertices it was created
+/// with, packed into a single array where the
+/// attributes of vertex i are
+/// data[i * numAttributes + {0, 1, ...}].
+///
+/// The object-space bounding box of the
+/// positions is computed once at creation so
+/// that draws which are entirely outside of
+/// the view frustum can be skipped without
+/// transforming any vertex
+////////////////////////////////////////
+struct TXvertexBuffer
+{
+    TXvec4* data;
+    int numVertices;
+    int numAttributes;
+    enum TXvertexInfo vertexInfo;
+
+    TXvec4 boundsMin;
+    TXvec4 boundsMax;
+};
+typedef struct TXvertexBuffer TXvertexBuffer_t;
+
+////////////////////////////////////////
+/// Index buffer object
+///
+/// Every 3 consecutive indices make up a
+/// triangle. maxIndex is computed once at
+/// creation so that drawing with a vertex
+/// buffer only has to check it against
+/// the number of vertices
+////////////////////////////////////////
+struct TXindexBuffer
+{
+    unsigned* indices;
+    int numIndices;
+    unsigned maxIndex;
+};
+typedef struct TXindexBuffer TXindexBuffer_t;
+
+////////////////////////////////////////
+/// Copies numVertices vertices given in the
+/// same form as txDrawTriangleStrip takes
+/// them into vertexBuffer.
+///
+/// Returns false if out of memory or if
+/// vertexInfo is invalid
+////////////////////////////////////////
+bool txCreateVertexBuffer(TXvertexBuffer_t* vertexBuffer,
+                          TXvec4* vertices[],
+                          int numVertices,
+                          enum TXvertexInfo vertexInfo);
+
+////////////////////////////////////////
+void txFreeVertexBuffer(TXvertexBuffer_t* vertexBuffer);
+
+////////////////////////////////////////
+/// Recomputes the bounding box of
+/// vertexBuffer from its positions
+////////////////////////////////////////
+void txComputeVertexBufferBounds(TXvertexBuffer_t* vertexBuffer);
+
+////////////////////////////////////////
+/// Copies numIndices indices into indexBuffer.
+/// Trailing indices that don't make up a whole
+/// triangle are dropped.
+///
+/// Returns false if out of memory
+////////////////////////////////////////
+bool txCreateIndexBuffer(TXindexBuffer_t* indexBuffer,
+                         unsigned* indices,
+                         int numIndices);
+
+////////////////////////////////////////
+void txFreeIndexBuffer(TXindexBuffer_t* indexBuffer);
+
+////////////////////////////////////////
+#ifdef __cplusplus
+}
+#endif
+////////////////////////////////////////
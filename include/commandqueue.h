@@ -0,0 +1,97 @@
+// Copyright (C) 2023 saccharineboi
+
+#pragma once
+
+////////////////////////////////////////
+#ifdef __cplusplus
+extern "C" {
+#endif
+////////////////////////////////////////
+
+#include <semaphore.h>
+#include <stdbool.h>
+
+////////////////////////////////////////
+/// Waits on semaphore, retrying
+/// when interrupted by a signal
+////////////////////////////////////////
+void txWaitSemaphore(sem_t* semaphore);
+
+////////////////////////////////////////
+/// Callback that executes a single command
+////////////////////////////////////////
+typedef void (*TXcommandCallback) (void* userData);
+
+////////////////////////////////////////
+struct TXcommand
+{
+    TXcommandCallback callback;
+    void* userData;
+};
+
+////////////////////////////////////////
+/// Bounded ring of commands with a single
+/// producer and a single consumer thread.
+///
+/// The producer only ever writes tail and
+/// the consumer only ever writes head, so
+/// they never take a lock. The semaphores
+/// count the filled and the free slots: they
+/// publish each command to the other side
+/// and put a thread to sleep only when the
+/// ring is empty (consumer) or full (producer)
+////////////////////////////////////////
+struct TXcommandQueue
+{
+    struct TXcommand* commands;
+    unsigned capacity;
+    unsigned head;
+    unsigned tail;
+
+    sem_t numCommands;
+    sem_t numFreeSlots;
+};
+typedef struct TXcommandQueue TXcommandQueue_t;
+
+////////////////////////////////////////
+/// Creates a queue with room for capacity
+/// commands. Returns false if capacity is 0,
+/// if out of memory or if the semaphores
+/// couldn't be created
+////////////////////////////////////////
+bool txCreateCommandQueue(TXcommandQueue_t* queue, unsigned capacity);
+
+////////////////////////////////////////
+/// Appends a command, blocking while
+/// the queue is full. Producer only
+////////////////////////////////////////
+void txPushCommand(TXcommandQueue_t* queue, TXcommandCallback callback, void* userData);
+
+////////////////////////////////////////
+/// Appends a command unless the queue
+/// is full. Producer only
+////////////////////////////////////////
+bool txTryPushCommand(TXcommandQueue_t* queue, TXcommandCallback callback, void* userData);
+
+////////////////////////////////////////
+/// Removes the oldest command, blocking while
+/// the queue is empty. Consumer only
+////////////////////////////////////////
+void txPopCommand(TXcommandQueue_t* queue, struct TXcommand* command);
+
+////////////////////////////////////////
+/// Removes the oldest command unless the
+/// queue is empty. Consumer only
+////////////////////////////////////////
+bool txTryPopCommand(TXcommandQueue_t* queue, struct TXcommand* command);
+
+////////////////////////////////////////
+/// Commands left in the queue are dropped
+////////////////////////////////////////
+void txDestroyCommandQueue(TXcommandQueue_t* queue);
+
+////////////////////////////////////////
+#ifdef __cplusplus
+}
+#endif
+////////////////////////////////////////
@@ -23,9 +23,15 @@ extern "C" {
 #include "transform.h"
 #include "pixel.h"
 #include "framebuffer.h"
+#include "buffer.h"
 #include "rasterizer.h"
+#include "displaylist.h"
+#include "span.h"
 #include "init.h"
 #include "error.h"
+#include "threadpool.h"
+#include "commandqueue.h"
+#include "jobrenderer.h"
 
 ////////////////////////////////////////
 #ifdef __cplusplus
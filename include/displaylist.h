@@ -0,0 +1,113 @@
+// Copyright (C) 2023 saccharineboi
+
+#pragma once
+
+////////////////////////////////////////
+#ifdef __cplusplus
+extern "C" {
+#endif
+////////////////////////////////////////
+
+#include "vec.h"
+#include "common.h"
+#include "buffer.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////
+/// Display lists
+///
+/// Triangles drawn between txNewList and
+/// txEndList are compiled into the list:
+/// their vertices are packed into vertex
+/// buffers (see TXvertexBuffer_t), one per
+/// run of draw calls sharing the same VAO
+/// configuration, and indexed so that vertices
+/// shared within a draw call are shaded once.
+/// Degenerate triangles are dropped while
+/// compiling.
+///
+/// txCallList then renders every vertex
+/// buffer of the list with txDrawVertexBuffer.
+///
+/// In contrast to OpenGL, only the geometry
+/// is recorded. Matrices, colors, shade model
+/// and so on are read when the list is called,
+/// so the same list can be drawn anywhere.
+/// Points and lines aren't recorded and are
+/// drawn right away.
+///
+/// Each thread compiles its own list, so draw
+/// calls of other threads aren't recorded into
+/// it. Names and compiled lists are shared by
+/// all threads, and a list MUST NOT be replaced
+/// or deleted while another thread calls it
+////////////////////////////////////////
+enum TXlistMode { TX_COMPILE,
+                  TX_COMPILE_AND_EXECUTE };
+
+////////////////////////////////////////
+/// Returns the first of range consecutive
+/// unused display list names, or 0 if
+/// out of memory
+////////////////////////////////////////
+unsigned txGenLists(int range);
+
+////////////////////////////////////////
+/// Starts compiling list. The previous
+/// contents of list are replaced once
+/// txEndList is called
+////////////////////////////////////////
+void txNewList(unsigned list, enum TXlistMode mode);
+
+////////////////////////////////////////
+void txEndList();
+
+////////////////////////////////////////
+void txCallList(unsigned list);
+
+////////////////////////////////////////
+/// Frees the lists [list, list + range)
+////////////////////////////////////////
+void txDeleteLists(unsigned list, int range);
+
+////////////////////////////////////////
+bool txIsList(unsigned list);
+
+////////////////////////////////////////
+/// Following functions are used by the
+/// draw calls to record their triangles
+////////////////////////////////////////
+
+////////////////////////////////////////
+/// Returns true if the calling thread
+/// is compiling a display list
+////////////////////////////////////////
+bool txIsCompilingList();
+
+////////////////////////////////////////
+enum TXlistMode txGetListMode();
+
+////////////////////////////////////////
+/// Appends a vertex to the list being
+/// compiled and returns its index, which is
+/// only valid until a vertex with a different
+/// VAO configuration is recorded. If vertexInfo
+/// is invalid nothing is recorded, and triangles
+/// made of the returned index are ignored
+////////////////////////////////////////
+unsigned txRecordVertex(enum TXvertexInfo vertexInfo, TXvec4 vertex[]);
+
+////////////////////////////////////////
+/// Appends the triangle made of the given
+/// vertices (see txRecordVertex) to the list
+/// being compiled unless it's degenerate or
+/// one of them wasn't recorded
+////////////////////////////////////////
+void txRecordTriangle(unsigned i0, unsigned i1, unsigned i2);
+
+////////////////////////////////////////
+#ifdef __cplusplus
+}
+#endif
+////////////////////////////////////////
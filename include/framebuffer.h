@@ -31,6 +31,37 @@ enum TXdepthFunc { TX_LESS,
                    TX_GREATER,
                    TX_NOTEQUAL };
 
+////////////////////////////////////////
+/// Width and height (in pixels) of the
+/// tiles of the hierarchical depth buffer
+////////////////////////////////////////
+#define TX_HIZ_TILE_SIZE 8
+
+////////////////////////////////////////
+/// Coarse depth information about a
+/// TX_HIZ_TILE_SIZE x TX_HIZ_TILE_SIZE tile
+/// of a framebuffer.
+///
+/// minDepth and maxDepth are conservative:
+/// every depth in the tile is guaranteed to be
+/// in [minDepth, maxDepth]. That's enough to
+/// reject triangles (or parts of them) that
+/// can't possibly pass the depth test without
+/// looking at individual pixels.
+////////////////////////////////////////
+struct TXhiZTile
+{
+    float minDepth;
+    float maxDepth;
+};
+typedef struct TXhiZTile TXhiZTile_t;
+
+////////////////////////////////////////
+/// Thread that presents framebuffers in the
+/// background, see txEnableAsyncPresent
+////////////////////////////////////////
+struct TXpresenter;
+
 ////////////////////////////////////////
 struct TXframebufferInfo
 {
@@ -52,9 +83,42 @@ struct TXframebufferInfo
     struct ncvisual_options options;
 
     uint32_t* raw_framebuffer;
+
+    // Hierarchical depth buffer of
+    // each framebuffer in framebuffers
+    TXhiZTile_t* hiZ[2];
+    int hiZWidth;
+    int hiZHeight;
+
+    // NULL unless presenting asynchronously
+    struct TXpresenter* presenter;
 };
 typedef struct TXframebufferInfo TXframebufferInfo_t;
 
+////////////////////////////////////////
+/// Returns true if interpolatedDepth passes
+/// the depth test given by depthFunc against
+/// the depth already stored in the pixel
+////////////////////////////////////////
+TX_FORCE_INLINE bool txDepthFuncPasses(enum TXdepthFunc depthFunc, float interpolatedDepth, float pixelDepth)
+{
+    switch (depthFunc) {
+        case TX_LESS:
+            return interpolatedDepth < pixelDepth;
+        case TX_LEQUAL:
+            return interpolatedDepth <= pixelDepth;
+        case TX_EQUAL:
+            return txFloatEquals(interpolatedDepth, pixelDepth);
+        case TX_GEQUAL:
+            return interpolatedDepth >= pixelDepth;
+        case TX_GREATER:
+            return interpolatedDepth > pixelDepth;
+        case TX_NOTEQUAL:
+            return !txFloatEquals(interpolatedDepth, pixelDepth);
+    }
+    return false;
+}
+
 ////////////////////////////////////////
 bool txCompareDepth(const TXappInfo_t* appInfo, const TXframebufferInfo_t* framebufferInfo, float interpolatedDepth, float pixelDepth);
 
@@ -82,9 +146,118 @@ bool txSetPixelInCurrentFramebuffer(TXframebufferInfo_t* framebufferInfo, int ro
 ////////////////////////////////////////
 bool txSetPixelInDisplayFramebuffer(TXframebufferInfo_t* framebufferInfo, int row, int col, TXpixel_t* pixel);
 
+////////////////////////////////////////
+/// Returns the hierarchical depth buffer tile
+/// of the current framebuffer that contains the
+/// pixel at (row, col), or NULL if there's none
+////////////////////////////////////////
+TX_FORCE_INLINE TXhiZTile_t* txGetHiZTileFromCurrentFramebuffer(const TXframebufferInfo_t* framebufferInfo, int row, int col)
+{
+    TXhiZTile_t* hiZ = framebufferInfo->hiZ[framebufferInfo->currentFramebuffer];
+    if (!hiZ || row < 0 || col < 0)
+        return NULL;
+
+    int tileRow = row / TX_HIZ_TILE_SIZE;
+    int tileCol = col / TX_HIZ_TILE_SIZE;
+    if (tileRow >= framebufferInfo->hiZHeight || tileCol >= framebufferInfo->hiZWidth)
+        return NULL;
+    return &hiZ[tileRow * framebufferInfo->hiZWidth + tileCol];
+}
+
+////////////////////////////////////////
+/// Returns true if no depth in [minDepth, maxDepth]
+/// can pass the depth test given by depthFunc
+/// anywhere in the given tile
+////////////////////////////////////////
+TX_FORCE_INLINE bool txHiZRejects(enum TXdepthFunc depthFunc, const TXhiZTile_t* tile, float minDepth, float maxDepth)
+{
+    switch (depthFunc) {
+        case TX_LESS:
+            return minDepth >= tile->maxDepth;
+        case TX_LEQUAL:
+            return minDepth > tile->maxDepth;
+        case TX_GEQUAL:
+            return maxDepth < tile->minDepth;
+        case TX_GREATER:
+            return maxDepth <= tile->minDepth;
+        case TX_EQUAL:
+        case TX_NOTEQUAL:
+            return false;
+    }
+    return false;
+}
+
+////////////////////////////////////////
+/// Widens the depth range of the tile so that
+/// it includes depth. Cheap way of keeping the
+/// tile conservative after writing a single pixel
+////////////////////////////////////////
+TX_FORCE_INLINE void txExpandHiZTile(TXhiZTile_t* tile, float depth)
+{
+    tile->minDepth = fminf(tile->minDepth, depth);
+    tile->maxDepth = fmaxf(tile->maxDepth, depth);
+}
+
+////////////////////////////////////////
+/// Recomputes the exact depth range of the
+/// tile of the current framebuffer that contains
+/// the pixel at (row, col) from its pixels.
+/// Should be called after writing to many
+/// pixels of the tile
+////////////////////////////////////////
+void txUpdateHiZTile(TXframebufferInfo_t* framebufferInfo, int row, int col);
+
+////////////////////////////////////////
+/// Converts the current framebuffer to RGBA,
+/// blits it and renders it with notcurses.
+///
+/// If asynchronous presentation is enabled,
+/// this only hands the current framebuffer
+/// over to the presenter thread (after waiting
+/// for the previous one to be presented) and
+/// returns right away
 ////////////////////////////////////////
 void txDrawFramebuffer(TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInfo, int offsetX, int offsetY, int limitX, int limitY);
 
+////////////////////////////////////////
+/// Asynchronous presentation
+///
+/// When enabled, txDrawFramebuffer no longer
+/// converts, blits and renders the framebuffer
+/// itself. A presenter thread takes the
+/// just-finished framebuffer over instead,
+/// so that terminal output overlaps with
+/// rasterizing the next frame into the other
+/// framebuffer of framebufferInfo.
+///
+/// The presented framebuffer (the display
+/// framebuffer once they're swapped) belongs
+/// to the presenter until the next call to
+/// txDrawFramebuffer or txWaitForPresent, so
+/// it MUST NOT be written to before that. The
+/// same goes for notcurses output functions,
+/// while input functions can be called
+/// at any time.
+///
+/// By default framebuffers are presented
+/// synchronously
+////////////////////////////////////////
+bool txEnableAsyncPresent(TXframebufferInfo_t* framebufferInfo);
+
+////////////////////////////////////////
+/// Waits for the framebuffer being
+/// presented and stops the presenter
+////////////////////////////////////////
+void txDisableAsyncPresent(TXframebufferInfo_t* framebufferInfo);
+
+////////////////////////////////////////
+/// Blocks until the presenter thread is
+/// done with the last framebuffer it was
+/// handed. Does nothing if asynchronous
+/// presentation is disabled
+////////////////////////////////////////
+void txWaitForPresent(TXframebufferInfo_t* framebufferInfo);
+
 ////////////////////////////////////////
 void txFreeFramebuffer(TXframebufferInfo_t* framebufferInfo);
 
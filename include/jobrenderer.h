@@ -0,0 +1,112 @@
+// Copyright (C) 2023 saccharineboi
+
+#pragma once
+
+////////////////////////////////////////
+#ifdef __cplusplus
+extern "C" {
+#endif
+////////////////////////////////////////
+
+#include "rasterizer.h"
+#include "threadpool.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////
+/// A camera and the offscreen framebuffer
+/// it renders to (see txRenderJobs)
+////////////////////////////////////////
+struct TXrenderJob
+{
+    TXframebufferInfo_t* framebufferInfo;
+
+    // Loaded into the matrix stacks
+    // before the job is drawn
+    TXmat4 projectionMatrix;
+    TXmat4 modelViewMatrix;
+    TXmat4 normalMatrix;
+
+    void* userData;
+};
+typedef struct TXrenderJob TXrenderJob_t;
+
+////////////////////////////////////////
+/// Draws the scene of a job with the API of
+/// rasterizer.h. sceneData is shared by all
+/// jobs, so it MUST only be read
+////////////////////////////////////////
+typedef void (*TXrenderJobCallback) (TXrenderJob_t* job, void* sceneData);
+
+////////////////////////////////////////
+/// Renders many independent jobs at once,
+/// e.g. thumbnails of the same meshes seen
+/// from different cameras.
+///
+/// Every thread of the pool, the calling one
+/// included, has a rendering context of its
+/// own (see TXcontext_t) which it binds to the
+/// framebuffer of each job it takes, so jobs
+/// share nothing but sceneData, light parameters
+/// and display lists. The latter two MUST NOT
+/// change during txRenderJobs either
+////////////////////////////////////////
+struct TXjobRenderer
+{
+    TXthreadPool_t pool;
+
+    // contexts[i] belongs to
+    // thread i of the pool
+    TXcontext_t** contexts;
+    int numContexts;
+
+    // Parameters of the running txRenderJobs
+    TXrenderJob_t* jobs;
+    TXrenderJobCallback draw;
+    void* sceneData;
+};
+typedef struct TXjobRenderer TXjobRenderer_t;
+
+////////////////////////////////////////
+/// Creates a job renderer whose jobs run on
+/// numThreads threads, the calling thread
+/// included, or on every core if numThreads
+/// is 0 or less. Returns false if the threads
+/// or the contexts couldn't be created
+////////////////////////////////////////
+bool txCreateJobRenderer(TXjobRenderer_t* renderer, int numThreads);
+
+////////////////////////////////////////
+/// Renders jobs[0] to jobs[numJobs - 1] and
+/// blocks until all of them are in their
+/// framebuffers.
+///
+/// Each job starts with the initial state (see
+/// txResetState), the matrices of the job and
+/// nothing enabled but what the flags of its
+/// framebuffer enable. draw then renders the
+/// scene, and whatever state it leaves behind
+/// doesn't leak into other jobs: draw may enable
+/// tiled rendering, the visibility buffer or
+/// the render thread, and they're disabled once
+/// it returns. Clearing the framebuffer is up
+/// to draw as well.
+///
+/// No two jobs can share a framebuffer, and
+/// the calling thread MUST NOT be recording
+/// a command buffer
+////////////////////////////////////////
+void txRenderJobs(TXjobRenderer_t* renderer,
+                  TXrenderJob_t jobs[],
+                  int numJobs,
+                  TXrenderJobCallback draw,
+                  void* sceneData);
+
+////////////////////////////////////////
+void txDestroyJobRenderer(TXjobRenderer_t* renderer);
+
+////////////////////////////////////////
+#ifdef __cplusplus
+}
+#endif
+////////////////////////////////////////
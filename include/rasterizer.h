@@ -14,13 +14,50 @@ extern "C" {
 #include "common.h"
 #include "framebuffer.h"
 #include "transform.h"
+#include "buffer.h"
 #include "error.h"
+#include "commandqueue.h"
 
 #include <unistd.h>
+#include <stdint.h>
 
 ////////////////////////////////////////
 #define TX_LINE_BIAS 0.5f
 #define TX_FB_BIAS   0.01f
+#define TX_HIZ_BIAS  1e-4f
+
+////////////////////////////////////////
+#define TX_DEFAULT_GUARD_BAND 8.0f
+
+////////////////////////////////////////
+/// Width and height (in pixels) of the
+/// screen tiles used by tiled rendering
+////////////////////////////////////////
+#define TX_TILE_SIZE 32
+
+////////////////////////////////////////
+/// Number of vertices transformed at once
+/// by batched draw calls (see txDrawPoints)
+////////////////////////////////////////
+#define TX_VERTEX_BATCH_SIZE 256
+
+////////////////////////////////////////
+/// Triangles whose bounding box has at most
+/// this many pixels are tested pixel by pixel
+/// during setup, so that the ones which cover
+/// no pixel are dropped right away
+////////////////////////////////////////
+#define TX_SMALL_TRIANGLE_PIXELS 8
+
+////////////////////////////////////////
+/// Number of commands the queue of the
+/// render thread holds before txSubmitCommand
+/// blocks, and number of flushed batches of
+/// triangles that can wait for it before
+/// txFlush blocks (see txEnableRenderThread)
+////////////////////////////////////////
+#define TX_RENDER_THREAD_COMMANDS 256
+#define TX_RENDER_THREAD_BATCHES  4
 
 ////////////////////////////////////////
 /// Specifies which face(s) of a triangle
@@ -51,6 +88,58 @@ enum TXcullFace { TX_NONE,
 ////////////////////////////////////////
 enum TXwindOrder { TX_CW, TX_CCW };
 
+////////////////////////////////////////
+/// Specifies how face culling decides
+/// which face of a triangle is visible
+///
+/// TX_CULL_IN_SCREEN_SPACE : from the sign of
+/// the triangle's area after projection. Triangles
+/// that cross w = 0 use the determinant of their
+/// clip-space x, y and w instead, which has the
+/// same sign but doesn't divide by w
+///
+/// TX_CULL_IN_VIEW_SPACE : from the angle between
+/// the triangle's normal and the direction to the
+/// eye in view-space (see txShouldCullFace)
+///
+/// By default triangles are culled in
+/// screen-space, which is a lot cheaper
+////////////////////////////////////////
+enum TXcullMode { TX_CULL_IN_SCREEN_SPACE,
+                  TX_CULL_IN_VIEW_SPACE };
+
+////////////////////////////////////////
+/// Client-side vertex arrays read by
+/// txDrawArrays and txDrawElements.
+///
+/// Each one is enabled with
+/// txEnableClientState and described with
+/// its pointer function (see txVertexPointer).
+/// TX_VERTEX_ARRAY must always be enabled, the
+/// others pick the VAO configuration of the
+/// draw call, e.g. enabling TX_COLOR_ARRAY and
+/// TX_NORMAL_ARRAY draws with
+/// TX_POSITION_COLOR_NORMAL.
+///
+/// By default all arrays are disabled
+////////////////////////////////////////
+enum TXclientState { TX_VERTEX_ARRAY,
+                     TX_COLOR_ARRAY,
+                     TX_NORMAL_ARRAY,
+                     TX_TEXCOORD_ARRAY };
+
+////////////////////////////////////////
+#define TX_NUM_CLIENT_STATES 4
+
+////////////////////////////////////////
+/// Type of the components of a client-side
+/// vertex array. TX_UNSIGNED_BYTE is only for
+/// colors, whose components are normalized
+/// to [0, 1]
+////////////////////////////////////////
+enum TXdataType { TX_FLOAT,
+                  TX_UNSIGNED_BYTE };
+
 ////////////////////////////////////////
 void txFrontFace(enum TXwindOrder frontFace);
 
@@ -63,6 +152,32 @@ void txCullFace(enum TXcullFace cullFace);
 ////////////////////////////////////////
 enum TXcullFace txGetCullFace();
 
+////////////////////////////////////////
+/// Enables or disables writing colors to
+/// the framebuffer.
+///
+/// While disabled, triangles are rasterized by
+/// a stripped-down loop that only runs the depth
+/// test and writes depths (if the depth mask
+/// allows it), without running the fragment
+/// shader. That makes for a cheap depth pre-pass,
+/// after which the color pass can be drawn with
+/// TX_LEQUAL or TX_EQUAL so that hidden pixels
+/// are never shaded.
+///
+/// By default colors are written
+////////////////////////////////////////
+void txColorMask(bool mask);
+
+////////////////////////////////////////
+bool txGetColorMask();
+
+////////////////////////////////////////
+void txCullMode(enum TXcullMode cullMode);
+
+////////////////////////////////////////
+enum TXcullMode txGetCullMode();
+
 ////////////////////////////////////////
 /// Following 4 functions:
 ///
@@ -177,6 +292,29 @@ void txSetWidthMultiplier(float widthMultiplier);
 ////////////////////////////////////////
 float txGetWidthMultiplier();
 
+////////////////////////////////////////
+/// Triangles are clipped against the near
+/// and far planes, and against a guard band
+/// around the viewport: a triangle is clipped
+/// by the left, right, bottom or top plane only
+/// if it reaches further than guardBand times
+/// the viewport's half-extent (in NDC units)
+/// from its center. Parts of triangles that are
+/// outside of the viewport but within the guard
+/// band are never visited by the rasterizer, so
+/// they cost nothing.
+///
+/// guardBand can't be less than 1.0 (the edges
+/// of the viewport). It's also limited by the
+/// fixed-point range of the rasterizer, see
+/// TX_SUBPIXEL_RANGE. Default is
+/// TX_DEFAULT_GUARD_BAND
+////////////////////////////////////////
+void txSetGuardBand(float guardBand);
+
+////////////////////////////////////////
+float txGetGuardBand();
+
 ////////////////////////////////////////
 TX_FORCE_INLINE void txCopyTransform(enum TXmatrixType dst,
                                      enum TXmatrixType src)
@@ -426,6 +564,219 @@ bool txIsPointInTriangle(int i,
                          TXvec3 v2,
                          TXvec3 weights);
 
+////////////////////////////////////////
+/// Edge functions of a triangle in
+/// screen-space. They're set up once per
+/// triangle so that the rasterizer can
+/// walk the bounding box with additions
+/// only, instead of calling
+/// txIsPointInTriangle (two divisions)
+/// on every pixel.
+///
+/// Each edge function is pre-scaled by
+/// the reciprocal of the triangle's area,
+/// so the stepped values ARE the barycentric
+/// coordinates of the current pixel, i.e.
+/// the same weights txIsPointInTriangle
+/// would have returned.
+///
+/// weights : barycentrics at the origin pixel
+/// dx      : change of weights per column
+/// dy      : change of weights per row
+///
+/// For more info check out Juan Pineda's
+/// "A Parallel Algorithm for Polygon Rasterization"
+/// and https://fgiesen.wordpress.com/2013/02/10/optimizing-the-basic-rasterizer/
+////////////////////////////////////////
+struct TXedgeFunctions {
+    TXvec3 weights;
+    TXvec3 dx;
+    TXvec3 dy;
+};
+typedef struct TXedgeFunctions TXedgeFunctions_t;
+
+////////////////////////////////////////
+/// Sets up the edge functions of a triangle
+/// defined by vertices { v0, v1, v2 } so that
+/// edges->weights holds the barycentric coordinates
+/// of the pixel (x, y).
+///
+/// Returns false if the triangle is degenerate
+/// (has zero area) and thus covers no pixels
+////////////////////////////////////////
+TX_FORCE_INLINE bool txSetupEdgeFunctions(TXedgeFunctions_t* edges,
+                                          TXvec3 v0,
+                                          TXvec3 v1,
+                                          TXvec3 v2,
+                                          int x,
+                                          int y)
+{
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+    if (txFloatEquals(area, 0.0f))
+        return false;
+    float invArea = 1.0f / area;
+
+    float px = (float)x;
+    float py = (float)y;
+
+    // Edge opposite to v0 (v1 -> v2)
+    edges->dx[0] = (v1[1] - v2[1]) * invArea;
+    edges->dy[0] = (v2[0] - v1[0]) * invArea;
+    edges->weights[0] = ((v2[0] - v1[0]) * (py - v1[1]) - (v2[1] - v1[1]) * (px - v1[0])) * invArea;
+
+    // Edge opposite to v1 (v2 -> v0)
+    edges->dx[1] = (v2[1] - v0[1]) * invArea;
+    edges->dy[1] = (v0[0] - v2[0]) * invArea;
+    edges->weights[1] = ((v0[0] - v2[0]) * (py - v2[1]) - (v0[1] - v2[1]) * (px - v2[0])) * invArea;
+
+    // Edge opposite to v2 (v0 -> v1)
+    edges->dx[2] = (v0[1] - v1[1]) * invArea;
+    edges->dy[2] = (v1[0] - v0[0]) * invArea;
+    edges->weights[2] = ((v1[0] - v0[0]) * (py - v0[1]) - (v1[1] - v0[1]) * (px - v0[0])) * invArea;
+
+    return true;
+}
+
+////////////////////////////////////////
+/// Returns true if the pixel whose
+/// barycentric coordinates are given by
+/// weights is inside the triangle
+////////////////////////////////////////
+TX_FORCE_INLINE bool txIsInsideEdgeFunctions(TXvec3 weights)
+{
+    return weights[0] >= 0.0f && weights[1] >= 0.0f && weights[2] >= 0.0f;
+}
+
+////////////////////////////////////////
+/// Window coordinates are snapped to a 28.4
+/// fixed-point grid before coverage is evaluated,
+/// i.e. every pixel is split into
+/// TX_SUBPIXEL_SCALE x TX_SUBPIXEL_SCALE subpixels.
+///
+/// Edge functions of snapped vertices are exact
+/// 32-bit integers as long as no coordinate is
+/// further than TX_SUBPIXEL_RANGE pixels away
+/// from the origin. Triangles that don't fit
+/// fall back to floating-point coverage
+////////////////////////////////////////
+#define TX_SUBPIXEL_BITS  4
+#define TX_SUBPIXEL_SCALE (1 << TX_SUBPIXEL_BITS)
+#define TX_SUBPIXEL_RANGE 1024.0f
+
+////////////////////////////////////////
+/// Integer edge functions of a triangle whose
+/// vertices have been snapped to subpixels.
+/// They decide which pixels are covered, while
+/// TXedgeFunctions still provides the barycentric
+/// coordinates for interpolation.
+///
+/// values     : edge functions at the origin pixel
+/// dx         : change of values per column
+/// dy         : change of values per row
+/// thresholds : a pixel is covered iff
+///              values[k] > thresholds[k] for all k
+///
+/// Edge functions are oriented so that they're
+/// positive inside the triangle regardless of its
+/// winding order. Pixels exactly on an edge belong
+/// to the triangle only if the edge is a top edge
+/// or a left edge (the fill rule of D3D and GL),
+/// thus pixels on an edge shared by two triangles
+/// are shaded exactly once
+////////////////////////////////////////
+struct TXfixedEdgeFunctions {
+    int32_t values[3];
+    int32_t dx[3];
+    int32_t dy[3];
+    int32_t thresholds[3];
+};
+typedef struct TXfixedEdgeFunctions TXfixedEdgeFunctions_t;
+
+////////////////////////////////////////
+/// Returns true if the vertices { v0, v1, v2 }
+/// can be snapped to subpixels without overflowing
+/// the integer edge functions
+////////////////////////////////////////
+TX_FORCE_INLINE bool txCanSnapToSubpixels(TXvec3 v0, TXvec3 v1, TXvec3 v2)
+{
+    return fabsf(v0[0]) < TX_SUBPIXEL_RANGE && fabsf(v0[1]) < TX_SUBPIXEL_RANGE &&
+           fabsf(v1[0]) < TX_SUBPIXEL_RANGE && fabsf(v1[1]) < TX_SUBPIXEL_RANGE &&
+           fabsf(v2[0]) < TX_SUBPIXEL_RANGE && fabsf(v2[1]) < TX_SUBPIXEL_RANGE;
+}
+
+////////////////////////////////////////
+/// Sets up the integer edge function of the
+/// edge a -> b at subpixel (px, py), scaled by
+/// sign so that it's positive inside the triangle
+////////////////////////////////////////
+TX_FORCE_INLINE void txSetupFixedEdge(TXfixedEdgeFunctions_t* fixedEdges,
+                                      int k,
+                                      int32_t ax,
+                                      int32_t ay,
+                                      int32_t bx,
+                                      int32_t by,
+                                      int32_t px,
+                                      int32_t py,
+                                      int32_t sign)
+{
+    fixedEdges->values[k] = sign * (int32_t)((int64_t)(bx - ax) * (py - ay) - (int64_t)(by - ay) * (px - ax));
+    fixedEdges->dx[k] = sign * (ay - by) * TX_SUBPIXEL_SCALE;
+    fixedEdges->dy[k] = sign * (bx - ax) * TX_SUBPIXEL_SCALE;
+
+    // In screen-space y points down, so a top edge is
+    // horizontal with the triangle below it, and a left
+    // edge has the triangle to its right
+    bool isTopLeft = fixedEdges->dx[k] > 0 || (fixedEdges->dx[k] == 0 && fixedEdges->dy[k] > 0);
+    fixedEdges->thresholds[k] = isTopLeft ? -1 : 0;
+}
+
+////////////////////////////////////////
+/// Snaps the vertices { v0, v1, v2 } to subpixels
+/// and sets up both the integer edge functions and
+/// the (matching) barycentric edge functions at
+/// pixel (x, y).
+///
+/// Vertices MUST pass txCanSnapToSubpixels.
+///
+/// Returns false if the snapped triangle
+/// is degenerate and thus covers no pixels
+////////////////////////////////////////
+TX_FORCE_INLINE bool txSetupFixedEdgeFunctions(TXfixedEdgeFunctions_t* fixedEdges,
+                                               TXedgeFunctions_t* edges,
+                                               TXvec3 v0,
+                                               TXvec3 v1,
+                                               TXvec3 v2,
+                                               int x,
+                                               int y)
+{
+    int32_t x0 = (int32_t)lrintf(v0[0] * (float)TX_SUBPIXEL_SCALE);
+    int32_t y0 = (int32_t)lrintf(v0[1] * (float)TX_SUBPIXEL_SCALE);
+    int32_t x1 = (int32_t)lrintf(v1[0] * (float)TX_SUBPIXEL_SCALE);
+    int32_t y1 = (int32_t)lrintf(v1[1] * (float)TX_SUBPIXEL_SCALE);
+    int32_t x2 = (int32_t)lrintf(v2[0] * (float)TX_SUBPIXEL_SCALE);
+    int32_t y2 = (int32_t)lrintf(v2[1] * (float)TX_SUBPIXEL_SCALE);
+
+    int64_t area = (int64_t)(x1 - x0) * (y2 - y0) - (int64_t)(y1 - y0) * (x2 - x0);
+    if (area == 0)
+        return false;
+    int32_t sign = area > 0 ? 1 : -1;
+
+    int32_t px = x * TX_SUBPIXEL_SCALE;
+    int32_t py = y * TX_SUBPIXEL_SCALE;
+
+    txSetupFixedEdge(fixedEdges, 0, x1, y1, x2, y2, px, py, sign);
+    txSetupFixedEdge(fixedEdges, 1, x2, y2, x0, y0, px, py, sign);
+    txSetupFixedEdge(fixedEdges, 2, x0, y0, x1, y1, px, py, sign);
+
+    float invArea = 1.0f / (float)(area * sign);
+    for (int k = 0; k < 3; ++k) {
+        edges->weights[k] = (float)fixedEdges->values[k] * invArea;
+        edges->dx[k] = (float)fixedEdges->dx[k] * invArea;
+        edges->dy[k] = (float)fixedEdges->dy[k] * invArea;
+    }
+    return true;
+}
+
 ////////////////////////////////////////
 /// Returns true if a point defined by
 /// (i, j) is on a line defined by
@@ -470,19 +821,45 @@ TX_FORCE_INLINE float txInterpolateLineDepth(int i,
 void txDrawLine(TXvec4 v0, TXvec4 v1);
 
 ////////////////////////////////////////
-TX_FORCE_INLINE void txDrawLineStrip(TXvec4* vertices, int numVertices)
-{
-    for (int i = 0; i < numVertices - 1; ++i)
-        txDrawLine(vertices[i], vertices[i + 1]);
-}
+/// Batched versions of txDrawPoint and
+/// txDrawLine: vertices are in world-space
+/// and are transformed TX_VERTEX_BATCH_SIZE
+/// at a time with a single model-view-projection
+/// matrix.
+///
+/// colors is optional. If it's NULL every primitive
+/// gets the current color (see txColor4f), otherwise
+/// vertex i has the color at colors + i * colorStride
+/// (in bytes, 0 meaning tightly packed TXvec4s), and
+/// colors are interpolated along lines.
+///
+/// txDrawLines draws a line between every pair of
+/// vertices, txDrawLineStrip connects each vertex to
+/// the next one, and txDrawLineLoop also connects
+/// the last vertex to the first one
+////////////////////////////////////////
+void txDrawPoints(TXvec4* vertices,
+                  int numVertices,
+                  float* colors,
+                  size_t colorStride);
 
 ////////////////////////////////////////
-TX_FORCE_INLINE void txDrawLineLoop(TXvec4* vertices, int numVertices)
-{
-    txDrawLineStrip(vertices, numVertices);
-    if (numVertices > 2)
-        txDrawLine(vertices[numVertices - 1], vertices[0]);
-}
+void txDrawLines(TXvec4* vertices,
+                 int numVertices,
+                 float* colors,
+                 size_t colorStride);
+
+////////////////////////////////////////
+void txDrawLineStrip(TXvec4* vertices,
+                     int numVertices,
+                     float* colors,
+                     size_t colorStride);
+
+////////////////////////////////////////
+void txDrawLineLoop(TXvec4* vertices,
+                    int numVertices,
+                    float* colors,
+                    size_t colorStride);
 
 ////////////////////////////////////////
 bool txShouldCullFace(TXvec3 view_v0,
@@ -572,51 +949,544 @@ void txDrawTriangle(TXvec4 v0[],
                     TXvec4 v2[],
                     enum TXvertexInfo vertexInfo);
 
+////////////////////////////////////////
+/// Tiled rendering
+///
+/// When enabled, txDrawTriangle no longer
+/// rasterizes on the calling thread. Instead
+/// clipped and set-up triangles are collected
+/// and, once txFlush is called, binned into
+/// TX_TILE_SIZE x TX_TILE_SIZE screen tiles
+/// that are rasterized and shaded in parallel
+/// by numThreads threads (the calling thread
+/// included). Each tile renders its triangles
+/// in submission order, so the result is the
+/// same as in immediate mode.
+///
+/// If numThreads is 0 or less, one thread per
+/// CPU core is used.
+///
+/// Shade model, color and depth state are captured
+/// when a triangle is submitted. Light parameters
+/// are read when the tiles are rendered, so don't
+/// change them before calling txFlush.
+///
+/// txFlush MUST be called before the framebuffer
+/// is presented. Points and lines flush
+/// automatically to preserve draw order.
+///
+/// By default tiled rendering is turned off
+////////////////////////////////////////
+bool txEnableTiledRendering(int numThreads);
+
+////////////////////////////////////////
+void txDisableTiledRendering();
+
+////////////////////////////////////////
+bool txIsTiledRenderingEnabled();
+
+////////////////////////////////////////
+/// Renders all triangles submitted since
+/// the last flush. Does nothing unless tiled
+/// rendering, the visibility buffer or the
+/// render thread is enabled. With the render
+/// thread, it only hands the triangles over
+/// and returns right away
+////////////////////////////////////////
+void txFlush();
+
+////////////////////////////////////////
+/// Visibility buffer
+///
+/// When enabled, triangles are set up as they're
+/// submitted but only rendered once txFlush is
+/// called, in two passes. The first one runs
+/// just the depth test and records, for every
+/// pixel, the last triangle that passed it. The
+/// second one then runs the fragment shader
+/// exactly once for every recorded pixel, so
+/// overdraw no longer costs any lighting. The
+/// result is the same as in immediate mode.
+///
+/// Combined with tiled rendering, both passes
+/// run per tile in parallel.
+///
+/// Like in tiled rendering, state is captured
+/// when a triangle is submitted while light
+/// parameters are read by txFlush, which MUST be
+/// called before the framebuffer is presented.
+/// Points and lines flush automatically.
+///
+/// By default the visibility buffer is turned off
+////////////////////////////////////////
+void txEnableVisibilityBuffer();
+
+////////////////////////////////////////
+void txDisableVisibilityBuffer();
+
+////////////////////////////////////////
+bool txIsVisibilityBufferEnabled();
+
+////////////////////////////////////////
+/// Occlusion queries
+///
+/// Every pixel of the triangles, lines and
+/// points drawn between txBeginQuery and
+/// txEndQuery that passes the depth test (or
+/// is covered, if the depth test is disabled)
+/// is counted into the query. A result of 0
+/// means that everything drawn was hidden.
+///
+/// In TX_SAMPLES_PASSED mode draws render
+/// as usual. In TX_SAMPLES_PASSED_NO_WRITE
+/// mode they write neither colors nor depths
+/// and don't run the fragment shader, which
+/// makes it cheap to test a bounding box
+/// before drawing the object inside of it.
+///
+/// With tiled rendering or the visibility
+/// buffer, triangles are only counted once
+/// they're rendered by txFlush, so query MUST
+/// outlive the draws until then. Reading
+/// the result of the previous frame avoids
+/// waiting for it.
+///
+/// A query belongs to the rendering context it
+/// was last begun on (see TXcontext_t). Only
+/// that context can wait for its result, so the
+/// result MUST be read before the context is
+/// destroyed
+////////////////////////////////////////
+enum TXqueryMode { TX_SAMPLES_PASSED,
+                   TX_SAMPLES_PASSED_NO_WRITE };
+
+////////////////////////////////////////
+struct TXquery
+{
+    unsigned samplesPassed;
+
+    // Number of batches of triangles (see
+    // txFlush) that must be rendered before
+    // samplesPassed is final
+    unsigned numBatches;
+
+    // Context the query was last begun
+    // on, NULL if it never was
+    struct TXcontext* context;
+};
+typedef struct TXquery TXquery_t;
+
+////////////////////////////////////////
+/// Prepares query for its first use. Zeroing
+/// the query has the same effect
+////////////////////////////////////////
+void txInitQuery(TXquery_t* query);
+
+////////////////////////////////////////
+/// Starts counting into query, resetting its
+/// result. Only one query can be active
+/// at a time, and a query whose result is
+/// still pending on another context can't
+/// be begun again
+////////////////////////////////////////
+void txBeginQuery(TXquery_t* query, enum TXqueryMode mode);
+
+////////////////////////////////////////
+void txEndQuery();
+
+////////////////////////////////////////
+/// Returns true if every triangle counted
+/// by query has been rendered
+////////////////////////////////////////
+bool txIsQueryResultAvailable(TXquery_t* query);
+
+////////////////////////////////////////
+/// Returns the number of pixels counted by
+/// query, calling txFinish first if its result
+/// isn't available yet. Returns 0 if the result
+/// is pending on another context
+////////////////////////////////////////
+unsigned txGetQueryResult(TXquery_t* query);
+
+////////////////////////////////////////
+/// Render thread
+///
+/// When enabled, draw calls still transform,
+/// clip and set up their triangles on the
+/// calling thread, but txFlush hands them to
+/// a dedicated render thread through a
+/// single-producer single-consumer queue of
+/// commands and returns right away. The render
+/// thread executes the commands in order,
+/// rasterizing and shading the triangles (in
+/// parallel if tiled rendering is enabled as
+/// well), so the application can prepare the
+/// next frame in the meantime.
+///
+/// Only set-up triangles and submitted commands
+/// are queued, not the calls of this API. Draw
+/// calls read vertices from memory the
+/// application may change as soon as they
+/// return, and getters such as txGetModelViewMatrix
+/// return the state right away, so recording
+/// the calls would mean copying every vertex
+/// and mirroring all of the state. Transforming
+/// and setting up is cheap next to rasterizing,
+/// shading and presenting, which is what the
+/// render thread takes over. Command buffers
+/// (see txBeginCommandBuffer) spread the set-up
+/// over several threads if it's still too slow.
+///
+/// Anything else that touches the framebuffer,
+/// such as clearing, resizing or presenting it,
+/// MUST then go through txSubmitCommand or
+/// txSubmitFrame so that it runs on the render
+/// thread in order with the triangles. Light
+/// parameters are read by the render thread,
+/// so only change them after txFinish.
+///
+/// Points and lines wait for the render thread
+/// (see txFinish) since they're drawn right away.
+///
+/// maxFramesInFlight (at least 1) is the number
+/// of frames txSubmitFrame lets the application
+/// run ahead of the render thread.
+///
+/// By default the render thread is turned off
+////////////////////////////////////////
+bool txEnableRenderThread(int maxFramesInFlight);
+
+////////////////////////////////////////
+/// Waits for every submitted command
+/// before stopping the render thread
+////////////////////////////////////////
+void txDisableRenderThread();
+
+////////////////////////////////////////
+bool txIsRenderThreadEnabled();
+
+////////////////////////////////////////
+/// Flushes the triangles submitted so far and
+/// runs callback after them on the render thread,
+/// or right away if it isn't enabled. userData
+/// MUST stay valid until callback runs
+////////////////////////////////////////
+void txSubmitCommand(TXcommandCallback callback, void* userData);
+
+////////////////////////////////////////
+/// Same as txSubmitCommand, where present ends
+/// the current frame (e.g. swaps the buffers).
+/// Blocks while maxFramesInFlight frames are
+/// still waiting for the render thread.
+///
+/// This is the frame fence: with the render
+/// thread enabled, applications that call
+/// txSwapBuffers at the end of each frame
+/// pass a callback that calls it instead
+////////////////////////////////////////
+void txSubmitFrame(TXcommandCallback present, void* userData);
+
+////////////////////////////////////////
+/// Flushes the triangles submitted so far and
+/// blocks until the render thread executed
+/// every command. Same as txFlush if the
+/// render thread isn't enabled
+////////////////////////////////////////
+void txFinish();
+
+////////////////////////////////////////
+/// Rendering contexts
+///
+/// A context owns everything this API keeps
+/// between calls: the state set through it
+/// (matrix stacks, color, shade model, face
+/// culling, color mask, client-side arrays,
+/// queries), tiled rendering, the visibility
+/// buffer, the render thread and the framebuffer
+/// triangles are rendered to.
+///
+/// Every function of this API acts on the
+/// current context of the calling thread, which
+/// is a default context shared by all threads
+/// until txMakeContextCurrent is called. Threads
+/// with different contexts can thus render to
+/// different framebuffers at the same time
+/// without sharing any state, while a context
+/// MUST be current on one thread at a time.
+///
+/// A context renders to the framebuffer bound
+/// to it (see txBindFramebuffer), and reads the
+/// depth test, depth function, depth mask and
+/// face culling from its flags, depthFunc and
+/// depthMask. A context without a framebuffer,
+/// such as the default one until it's bound,
+/// renders to the default framebuffer with the
+/// global depth and culling state. Only bound
+/// framebuffers get hierarchical depth culling,
+/// since the default one doesn't expose its
+/// hierarchical depth buffer.
+///
+/// Light parameters are still shared by all
+/// contexts, so they MUST NOT change while other
+/// threads render. Display lists are shared too
+/// (see displaylist.h)
+////////////////////////////////////////
+typedef struct TXcontext TXcontext_t;
+
+////////////////////////////////////////
+/// Returns a new context with the initial
+/// state, bound to framebufferInfo (which
+/// can be NULL), or NULL if out of memory
+////////////////////////////////////////
+TXcontext_t* txCreateContext(TXframebufferInfo_t* framebufferInfo);
+
+////////////////////////////////////////
+/// Waits for everything submitted to context
+/// and frees it. It MUST NOT be current on
+/// any other thread
+////////////////////////////////////////
+void txDestroyContext(TXcontext_t* context);
+
+////////////////////////////////////////
+/// Makes context the current context of the
+/// calling thread, or the default context if
+/// context is NULL. Not allowed while recording
+/// a command buffer
+////////////////////////////////////////
+void txMakeContextCurrent(TXcontext_t* context);
+
+////////////////////////////////////////
+TXcontext_t* txGetCurrentContext();
+
+////////////////////////////////////////
+/// Binds framebufferInfo to the current context
+/// after rendering the triangles submitted so
+/// far (see txFinish). NULL makes it render
+/// to the default framebuffer again
+////////////////////////////////////////
+void txBindFramebuffer(TXframebufferInfo_t* framebufferInfo);
+
+////////////////////////////////////////
+/// Returns the framebuffer bound to the current
+/// context, NULL for the default framebuffer
+////////////////////////////////////////
+TXframebufferInfo_t* txGetBoundFramebuffer();
+
+////////////////////////////////////////
+/// Restores the initial state of the current
+/// context (matrix stacks, color, shade model,
+/// face culling, color mask and client-side
+/// arrays) and ends the active query, if any.
+/// The bound framebuffer and whether tiled
+/// rendering, the visibility buffer and the
+/// render thread are enabled don't change
+////////////////////////////////////////
+void txResetState();
+
+////////////////////////////////////////
+/// Command buffers
+///
+/// A command buffer records the triangles of
+/// draw calls instead of rendering them, so that
+/// several threads can transform, clip and set
+/// up triangles at once, e.g. one thread per
+/// part of the scene, each with its own buffer.
+/// txSubmitCommandBuffers then renders the buffers
+/// in the order it's given them, no matter which
+/// thread finished recording first.
+///
+/// Every buffer has its own copy of the state set
+/// through this API: matrix stacks, color, shade
+/// model, face culling, color mask and client-side
+/// arrays. The copy is taken from the current
+/// context of the thread that creates or resets
+/// the buffer, and the thread recording it only
+/// changes the buffer's copy. The buffer can
+/// only be submitted to that context.
+///
+/// Only triangles are recorded. Points, lines,
+/// queries, txFlush and txFinish are ignored while
+/// recording, and no display list can be compiled
+/// meanwhile. Depth, framebuffer and light state
+/// aren't copied, so they MUST NOT change while
+/// buffers are recorded. Triangles are set up for
+/// the framebuffer bound to the context, so buffers
+/// recorded before it's rebound or resized are
+/// skipped by txSubmitCommandBuffers. Tiled
+/// rendering, the visibility buffer and the
+/// render thread can be turned on or off between
+/// recording a buffer and submitting it
+////////////////////////////////////////
+typedef struct TXcommandBuffer TXcommandBuffer_t;
+
+////////////////////////////////////////
+/// Returns a new command buffer with a copy of
+/// the state of the current context, or NULL
+/// if out of memory
+////////////////////////////////////////
+TXcommandBuffer_t* txCreateCommandBuffer();
+
+////////////////////////////////////////
+void txFreeCommandBuffer(TXcommandBuffer_t* buffer);
+
+////////////////////////////////////////
+/// Drops the triangles recorded into buffer
+/// and copies the state of the current
+/// context into it again
+////////////////////////////////////////
+void txResetCommandBuffer(TXcommandBuffer_t* buffer);
+
+////////////////////////////////////////
+/// Until txEndCommandBuffer, draw calls of the
+/// calling thread use the state of buffer and
+/// append their triangles to it. A buffer can
+/// only be recorded by one thread at a time.
+///
+/// Triangles recorded before for a framebuffer
+/// that has since been rebound or resized are
+/// dropped
+////////////////////////////////////////
+void txBeginCommandBuffer(TXcommandBuffer_t* buffer);
+
+////////////////////////////////////////
+void txEndCommandBuffer();
+
+////////////////////////////////////////
+/// Renders the triangles recorded into buffers[0]
+/// to buffers[numBuffers - 1] in that order, as if
+/// the calling thread had just drawn them, and
+/// empties the buffers. None of them can be
+/// being recorded, and buffers recorded for
+/// another context or framebuffer are skipped.
+///
+/// With tiled rendering, the visibility buffer
+/// or the render thread, the triangles are
+/// rendered by the next txFlush instead
+////////////////////////////////////////
+void txSubmitCommandBuffers(TXcommandBuffer_t* buffers[], int numBuffers);
+
 ////////////////////////////////////////
 /// Rasterizes the given quad defined by four
 /// vertices { v0, v1, v2, v3 } in world-space
+///
+/// Each vertex goes through the vertex
+/// shader once even though the quad is
+/// rendered as 2 triangles
 ////////////////////////////////////////
-TX_FORCE_INLINE void txDrawQuad(TXvec4 v0[],
-                                TXvec4 v1[],
-                                TXvec4 v2[],
-                                TXvec4 v3[],
-                                enum TXvertexInfo vertexInfo)
-{
-    txDrawTriangle(v0, v1, v2, vertexInfo);
-    txDrawTriangle(v0, v2, v3, vertexInfo);
-}
+void txDrawQuad(TXvec4 v0[],
+                TXvec4 v1[],
+                TXvec4 v2[],
+                TXvec4 v3[],
+                enum TXvertexInfo vertexInfo);
 
 ////////////////////////////////////////
 /// Rasterizes the given triangle strip
 /// given by vertex array in vertices[]
 /// where each vertex is in world-space
+///
+/// Each vertex goes through the vertex
+/// shader once
 ////////////////////////////////////////
-TX_FORCE_INLINE void txDrawTriangleStrip(TXvec4* vertices[],
-                                         int numVertices,
-                                         enum TXvertexInfo vertexInfo)
-{
-    for (int i = 0; i < numVertices - 2; ++i) {
-        if (!i || !(i % 2))
-            txDrawTriangle(vertices[i + 2], vertices[i + 1], vertices[i], vertexInfo);
-        else
-            txDrawTriangle(vertices[i], vertices[i + 1], vertices[i + 2], vertexInfo);
-    }
-}
+void txDrawTriangleStrip(TXvec4* vertices[],
+                         int numVertices,
+                         enum TXvertexInfo vertexInfo);
 
 ////////////////////////////////////////
 /// Rasterizes the given triangle fan
 /// given by vertex array in vertices[]
 /// where each vertex is in world-space
+///
+/// Each vertex goes through the vertex
+/// shader once
 ////////////////////////////////////////
-TX_FORCE_INLINE void txDrawTriangleFan(TXvec4* vertices[],
-                                       int numVertices,
-                                       enum TXvertexInfo vertexInfo)
-{
-    for (int i = 0; i < numVertices - 2; ++i)
-        txDrawTriangle(vertices[0],
-                       vertices[i + 1],
-                       vertices[i + 2], vertexInfo);
-}
+void txDrawTriangleFan(TXvec4* vertices[],
+                       int numVertices,
+                       enum TXvertexInfo vertexInfo);
+
+////////////////////////////////////////
+/// Rasterizes numIndices / 3 triangles whose
+/// vertices are given by indices into the
+/// vertex array in vertices[], where each
+/// vertex is in world-space
+///
+/// Each vertex referenced by indices goes
+/// through the vertex shader once, no matter
+/// how many triangles share it. Triangles
+/// referencing a vertex out of
+/// [0, numVertices) are skipped
+////////////////////////////////////////
+void txDrawIndexedTriangles(TXvec4* vertices[],
+                            int numVertices,
+                            unsigned* indices,
+                            int numIndices,
+                            enum TXvertexInfo vertexInfo);
+
+////////////////////////////////////////
+/// Rasterizes the triangles stored in
+/// vertexBuffer. If indexBuffer is NULL every
+/// 3 consecutive vertices make up a triangle,
+/// otherwise every 3 consecutive indices do,
+/// and each vertex goes through the vertex
+/// shader once like in txDrawIndexedTriangles.
+///
+/// Nothing is drawn if the bounding box of
+/// vertexBuffer is outside of the view frustum
+/// or if indexBuffer references a vertex
+/// vertexBuffer doesn't have
+////////////////////////////////////////
+void txDrawVertexBuffer(TXvertexBuffer_t* vertexBuffer,
+                        TXindexBuffer_t* indexBuffer);
+
+////////////////////////////////////////
+void txEnableClientState(enum TXclientState array);
+
+////////////////////////////////////////
+void txDisableClientState(enum TXclientState array);
+
+////////////////////////////////////////
+/// Following 4 functions describe where
+/// txDrawArrays and txDrawElements find the
+/// attributes of vertex i, namely at
+/// pointer + i * stride, where each attribute
+/// has size components of the given type.
+///
+/// A stride of 0 means the attributes are
+/// tightly packed. Nothing is copied, so the
+/// arrays MUST stay valid until the draw
+/// call that uses them returns.
+///
+/// Missing components are filled in like
+/// in OpenGL, e.g. a position with size 3
+/// gets w = 1 and a color with size 3
+/// gets alpha = 1. Arrays other than colors
+/// MUST be TX_FLOAT
+////////////////////////////////////////
+void txVertexPointer(int size, enum TXdataType type, size_t stride, const void* pointer);
+
+////////////////////////////////////////
+void txColorPointer(int size, enum TXdataType type, size_t stride, const void* pointer);
+
+////////////////////////////////////////
+void txNormalPointer(enum TXdataType type, size_t stride, const void* pointer);
+
+////////////////////////////////////////
+void txTexCoordPointer(int size, enum TXdataType type, size_t stride, const void* pointer);
+
+////////////////////////////////////////
+/// Rasterizes count / 3 triangles made of
+/// vertices [first, first + count) of the
+/// enabled client-side arrays
+////////////////////////////////////////
+void txDrawArrays(int first, int count);
+
+////////////////////////////////////////
+/// Rasterizes count / 3 triangles whose
+/// vertices are given by indices into the
+/// enabled client-side arrays. Each vertex
+/// goes through the vertex shader once, like
+/// in txDrawIndexedTriangles
+////////////////////////////////////////
+void txDrawElements(unsigned* indices, int count);
 
 ////////////////////////////////////////
 #ifdef __cplusplus
@@ -0,0 +1,275 @@
+// Copyright (C) 2023 saccharineboi
+
+#pragma once
+
+////////////////////////////////////////
+#ifdef __cplusplus
+extern "C" {
+#endif
+////////////////////////////////////////
+
+#include "vec.h"
+#include "pixel.h"
+#include "common.h"
+#include "framebuffer.h"
+#include "rasterizer.h"
+
+#include <stddef.h>
+
+////////////////////////////////////////
+/// Span kernels evaluate coverage and the
+/// depth test of TX_SPAN_WIDTH horizontally
+/// adjacent pixels at once. Which kernel is
+/// used depends on the instruction sets
+/// enabled at compile time (CMakeLists.txt
+/// builds with -march=native):
+///
+/// * AVX2   : 8 pixels per span
+/// * SSE4.1 : 4 pixels per span
+/// * other  : 1 pixel per span (scalar)
+////////////////////////////////////////
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define TX_SPAN_WIDTH 8
+#elif defined(__SSE4_1__)
+    #include <smmintrin.h>
+    #define TX_SPAN_WIDTH 4
+#else
+    #define TX_SPAN_WIDTH 1
+#endif
+
+////////////////////////////////////////
+/// Distance (in floats) between the depth
+/// values of two neighboring pixels
+////////////////////////////////////////
+#define TX_PIXEL_STRIDE ((int)(sizeof(TXpixel_t) / sizeof(float)))
+
+#if defined(__AVX2__)
+
+////////////////////////////////////////
+TX_FORCE_INLINE __m256 txSpanCompareDepth8(enum TXdepthFunc depthFunc, __m256 z, __m256 d)
+{
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 tolerance, equal;
+    switch (depthFunc) {
+        case TX_LESS:
+            return _mm256_cmp_ps(z, d, _CMP_LT_OQ);
+        case TX_LEQUAL:
+            return _mm256_cmp_ps(z, d, _CMP_LE_OQ);
+        case TX_GEQUAL:
+            return _mm256_cmp_ps(z, d, _CMP_GE_OQ);
+        case TX_GREATER:
+            return _mm256_cmp_ps(z, d, _CMP_GT_OQ);
+        case TX_EQUAL:
+        case TX_NOTEQUAL:
+            // Same as txFloatEquals
+            tolerance = _mm256_max_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(_mm256_and_ps(z, absMask),
+                                                                          _mm256_and_ps(d, absMask)));
+            tolerance = _mm256_mul_ps(tolerance, _mm256_set1_ps(TX_EPSILON));
+            equal = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(z, d), absMask), tolerance, _CMP_LE_OQ);
+            if (depthFunc == TX_EQUAL)
+                return equal;
+            return _mm256_xor_ps(equal, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+    }
+    return _mm256_setzero_ps();
+}
+
+#elif defined(__SSE4_1__)
+
+////////////////////////////////////////
+TX_FORCE_INLINE __m128 txSpanCompareDepth4(enum TXdepthFunc depthFunc, __m128 z, __m128 d)
+{
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 tolerance, equal;
+    switch (depthFunc) {
+        case TX_LESS:
+            return _mm_cmplt_ps(z, d);
+        case TX_LEQUAL:
+            return _mm_cmple_ps(z, d);
+        case TX_GEQUAL:
+            return _mm_cmpge_ps(z, d);
+        case TX_GREATER:
+            return _mm_cmpgt_ps(z, d);
+        case TX_EQUAL:
+        case TX_NOTEQUAL:
+            // Same as txFloatEquals
+            tolerance = _mm_max_ps(_mm_set1_ps(1.0f), _mm_max_ps(_mm_and_ps(z, absMask),
+                                                                 _mm_and_ps(d, absMask)));
+            tolerance = _mm_mul_ps(tolerance, _mm_set1_ps(TX_EPSILON));
+            equal = _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(z, d), absMask), tolerance);
+            if (depthFunc == TX_EQUAL)
+                return equal;
+            return _mm_xor_ps(equal, _mm_castsi128_ps(_mm_set1_epi32(-1)));
+    }
+    return _mm_setzero_ps();
+}
+
+#endif
+
+////////////////////////////////////////
+/// Evaluates coverage and (if depthTest is true)
+/// the depth test of the count (at most TX_SPAN_WIDTH)
+/// pixels starting at pixels[0].
+///
+/// weights are the barycentric coordinates of the
+/// first pixel and dx is their change per column
+/// (see TXedgeFunctions in rasterizer.h), zValues
+/// are the inverted depths of the triangle's vertices.
+///
+/// If fixedEdges isn't NULL coverage is decided by
+/// the integer edge functions, with fixedValues being
+/// their values at the first pixel. Otherwise it's
+/// decided by the signs of the barycentric coordinates.
+/// If testCoverage is false, the caller knows that
+/// every pixel is covered and coverage isn't tested.
+///
+/// The interpolated depth of every pixel is stored
+/// in depths. Returns a mask where bit k is set if
+/// pixel k is covered by the triangle and passed the
+/// depth test, i.e. must go to the fragment shader
+////////////////////////////////////////
+TX_FORCE_INLINE unsigned txSpanCoverageDepth(TXvec3 weights,
+                                             TXvec3 dx,
+                                             const TXfixedEdgeFunctions_t* fixedEdges,
+                                             const int32_t fixedValues[3],
+                                             TXvec3 zValues,
+                                             TXpixel_t* pixels,
+                                             int count,
+                                             bool testCoverage,
+                                             bool depthTest,
+                                             enum TXdepthFunc depthFunc,
+                                             float depths[TX_SPAN_WIDTH])
+{
+#if defined(__AVX2__)
+    __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 w0 = _mm256_add_ps(_mm256_set1_ps(weights[0]), _mm256_mul_ps(lanes, _mm256_set1_ps(dx[0])));
+    __m256 w1 = _mm256_add_ps(_mm256_set1_ps(weights[1]), _mm256_mul_ps(lanes, _mm256_set1_ps(dx[1])));
+    __m256 w2 = _mm256_add_ps(_mm256_set1_ps(weights[2]), _mm256_mul_ps(lanes, _mm256_set1_ps(dx[2])));
+
+    __m256 inside;
+    if (!testCoverage) {
+        inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    } else if (fixedEdges) {
+        __m256i inside0 = _mm256_cmpgt_epi32(_mm256_add_epi32(_mm256_set1_epi32(fixedValues[0]),
+                                                              _mm256_mullo_epi32(laneIndices, _mm256_set1_epi32(fixedEdges->dx[0]))),
+                                             _mm256_set1_epi32(fixedEdges->thresholds[0]));
+        __m256i inside1 = _mm256_cmpgt_epi32(_mm256_add_epi32(_mm256_set1_epi32(fixedValues[1]),
+                                                              _mm256_mullo_epi32(laneIndices, _mm256_set1_epi32(fixedEdges->dx[1]))),
+                                             _mm256_set1_epi32(fixedEdges->thresholds[1]));
+        __m256i inside2 = _mm256_cmpgt_epi32(_mm256_add_epi32(_mm256_set1_epi32(fixedValues[2]),
+                                                              _mm256_mullo_epi32(laneIndices, _mm256_set1_epi32(fixedEdges->dx[2]))),
+                                             _mm256_set1_epi32(fixedEdges->thresholds[2]));
+        inside = _mm256_castsi256_ps(_mm256_and_si256(_mm256_and_si256(inside0, inside1), inside2));
+    } else {
+        __m256 zero = _mm256_setzero_ps();
+        inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ),
+                                             _mm256_cmp_ps(w1, zero, _CMP_GE_OQ)),
+                               _mm256_cmp_ps(w2, zero, _CMP_GE_OQ));
+    }
+
+    __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, _mm256_set1_ps(zValues[0])),
+                                           _mm256_mul_ps(w1, _mm256_set1_ps(zValues[1]))),
+                             _mm256_mul_ps(w2, _mm256_set1_ps(zValues[2])));
+    _mm256_storeu_ps(depths, z);
+
+    __m256 valid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), laneIndices));
+    inside = _mm256_and_ps(inside, valid);
+
+    if (depthTest && _mm256_movemask_ps(inside)) {
+        // Only gather the depths of pixels that exist,
+        // the span may hang over the end of the framebuffer
+        __m256i offsets = _mm256_mullo_epi32(laneIndices, _mm256_set1_epi32(TX_PIXEL_STRIDE));
+        __m256 d = _mm256_mask_i32gather_ps(_mm256_set1_ps(0.0f), &pixels[0].depth, offsets, inside, 4);
+        inside = _mm256_and_ps(inside, txSpanCompareDepth8(depthFunc, z, d));
+    }
+    return (unsigned)_mm256_movemask_ps(inside);
+#elif defined(__SSE4_1__)
+    __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128i laneIndices = _mm_setr_epi32(0, 1, 2, 3);
+
+    __m128 w0 = _mm_add_ps(_mm_set1_ps(weights[0]), _mm_mul_ps(lanes, _mm_set1_ps(dx[0])));
+    __m128 w1 = _mm_add_ps(_mm_set1_ps(weights[1]), _mm_mul_ps(lanes, _mm_set1_ps(dx[1])));
+    __m128 w2 = _mm_add_ps(_mm_set1_ps(weights[2]), _mm_mul_ps(lanes, _mm_set1_ps(dx[2])));
+
+    __m128 inside;
+    if (!testCoverage) {
+        inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    } else if (fixedEdges) {
+        __m128i inside0 = _mm_cmpgt_epi32(_mm_add_epi32(_mm_set1_epi32(fixedValues[0]),
+                                                        _mm_mullo_epi32(laneIndices, _mm_set1_epi32(fixedEdges->dx[0]))),
+                                          _mm_set1_epi32(fixedEdges->thresholds[0]));
+        __m128i inside1 = _mm_cmpgt_epi32(_mm_add_epi32(_mm_set1_epi32(fixedValues[1]),
+                                                        _mm_mullo_epi32(laneIndices, _mm_set1_epi32(fixedEdges->dx[1]))),
+                                          _mm_set1_epi32(fixedEdges->thresholds[1]));
+        __m128i inside2 = _mm_cmpgt_epi32(_mm_add_epi32(_mm_set1_epi32(fixedValues[2]),
+                                                        _mm_mullo_epi32(laneIndices, _mm_set1_epi32(fixedEdges->dx[2]))),
+                                          _mm_set1_epi32(fixedEdges->thresholds[2]));
+        inside = _mm_castsi128_ps(_mm_and_si128(_mm_and_si128(inside0, inside1), inside2));
+    } else {
+        __m128 zero = _mm_setzero_ps();
+        inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero),
+                                       _mm_cmpge_ps(w1, zero)),
+                            _mm_cmpge_ps(w2, zero));
+    }
+
+    __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(zValues[0])),
+                                     _mm_mul_ps(w1, _mm_set1_ps(zValues[1]))),
+                          _mm_mul_ps(w2, _mm_set1_ps(zValues[2])));
+    _mm_storeu_ps(depths, z);
+
+    __m128 valid = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(count), laneIndices));
+    inside = _mm_and_ps(inside, valid);
+
+    unsigned mask = (unsigned)_mm_movemask_ps(inside);
+    if (depthTest && mask) {
+        __m128 d = _mm_setr_ps(count > 0 ? pixels[0].depth : 0.0f,
+                               count > 1 ? pixels[1].depth : 0.0f,
+                               count > 2 ? pixels[2].depth : 0.0f,
+                               count > 3 ? pixels[3].depth : 0.0f);
+        mask &= (unsigned)_mm_movemask_ps(txSpanCompareDepth4(depthFunc, z, d));
+    }
+    return mask;
+#else
+    depths[0] = txVec3Dot(zValues, weights);
+    if (count < 1)
+        return 0;
+    (void)dx;
+    if (!testCoverage) {
+        // Every pixel is covered
+    } else if (fixedEdges) {
+        if (fixedValues[0] <= fixedEdges->thresholds[0] ||
+            fixedValues[1] <= fixedEdges->thresholds[1] ||
+            fixedValues[2] <= fixedEdges->thresholds[2])
+            return 0;
+    } else if (weights[0] < 0.0f || weights[1] < 0.0f || weights[2] < 0.0f) {
+        return 0;
+    }
+    if (depthTest && !txDepthFuncPasses(depthFunc, depths[0], pixels[0].depth))
+        return 0;
+    return 1;
+#endif
+}
+
+////////////////////////////////////////
+/// Returns the number of pixels set in
+/// a mask returned by txSpanCoverageDepth
+////////////////////////////////////////
+TX_FORCE_INLINE unsigned txSpanCountPixels(unsigned mask)
+{
+#ifdef __GNUC__
+    return (unsigned)__builtin_popcount(mask);
+#else
+    unsigned count = 0;
+    for (; mask; mask &= mask - 1)
+        ++count;
+    return count;
+#endif
+}
+
+////////////////////////////////////////
+#ifdef __cplusplus
+}
+#endif
+////////////////////////////////////////
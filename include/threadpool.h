@@ -0,0 +1,83 @@
+// Copyright (C) 2023 saccharineboi
+
+#pragma once
+
+////////////////////////////////////////
+#ifdef __cplusplus
+extern "C" {
+#endif
+////////////////////////////////////////
+
+#include <pthread.h>
+#include <stdbool.h>
+
+////////////////////////////////////////
+/// Callback that processes a single job.
+///
+/// jobIndex is in [0, numJobs) and threadIndex
+/// is in [0, numThreads], where index 0 is
+/// the thread that called txRunJobs
+////////////////////////////////////////
+typedef void (*TXjobCallback) (void* userData, int jobIndex, int threadIndex);
+
+////////////////////////////////////////
+/// A fixed set of worker threads that sleep
+/// until txRunJobs hands them a batch of jobs.
+///
+/// Jobs of a batch are handed out one at a time
+/// to whichever thread is free, so there's no
+/// guarantee which thread runs which job. The
+/// calling thread works on the batch as well
+/// and txRunJobs returns only after every job
+/// of the batch is finished
+////////////////////////////////////////
+struct TXthreadPool
+{
+    pthread_t* threads;
+    int numThreads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;
+    pthread_cond_t doneCond;
+
+    TXjobCallback callback;
+    void* userData;
+
+    int numJobs;
+    int nextJob;
+    int numJobsDone;
+
+    bool quit;
+};
+typedef struct TXthreadPool TXthreadPool_t;
+
+////////////////////////////////////////
+/// Returns the number of online CPU cores
+////////////////////////////////////////
+int txGetNumCores();
+
+////////////////////////////////////////
+/// Spawns numThreads worker threads.
+/// numThreads may be 0, in which case
+/// txRunJobs runs every job on the
+/// calling thread
+////////////////////////////////////////
+bool txCreateThreadPool(TXthreadPool_t* pool, int numThreads);
+
+////////////////////////////////////////
+/// Runs callback for every job in [0, numJobs)
+/// and blocks until all of them are done.
+///
+/// Must not be called from within a job
+/// of the same pool
+////////////////////////////////////////
+void txRunJobs(TXthreadPool_t* pool, TXjobCallback callback, void* userData, int numJobs);
+
+////////////////////////////////////////
+void txDestroyThreadPool(TXthreadPool_t* pool);
+
+////////////////////////////////////////
+#ifdef __cplusplus
+}
+#endif
+////////////////////////////////////////
@@ -282,6 +282,13 @@ TX_FORCE_INLINE void txMulMat4Vec3(TXvec3 res, TXmat4 mat, TXvec3 v, float w)
     res[2] = mat[2] * v0 + mat[6] * v1 + mat[10] * v2 + mat[14] * w;
 }
 
+////////////////////////////////////////
+/// Computes dst[i] = mat * src[i] for
+/// numVertices vertices in a single pass.
+/// dst and src may be the same array
+////////////////////////////////////////
+void txTransformVertices(TXvec4* dst, TXmat4 mat, TXvec4* src, int numVertices);
+
 ////////////////////////////////////////
 /// Specification of a triangle that
 /// CursedGL uses internally for things like
@@ -351,6 +358,91 @@ int txClipTriangleAgainstPlane(TXtriangle_t* tri0_out,
                                TXvec3 planeNormal,
                                TXtriangle_t* tri0_in);
 
+////////////////////////////////////////
+/// Clip-space planes a vertex can be outside of.
+///
+/// x and y are tested against a guard band:
+/// vertex v is inside the left plane if
+/// v.x >= -guardBand * v.w, where guardBand is
+/// given in NDC units (1.0 being the edges of the
+/// viewport). Triangles that stick out of the
+/// viewport but stay within the guard band
+/// aren't clipped, the rasterizer simply
+/// doesn't visit pixels outside of the viewport.
+///
+/// Near and far planes have no guard band
+////////////////////////////////////////
+#define TX_CLIP_LEFT   (1u << 0)
+#define TX_CLIP_RIGHT  (1u << 1)
+#define TX_CLIP_BOTTOM (1u << 2)
+#define TX_CLIP_TOP    (1u << 3)
+#define TX_CLIP_NEAR   (1u << 4)
+#define TX_CLIP_FAR    (1u << 5)
+
+#define TX_NUM_CLIP_PLANES 6
+
+////////////////////////////////////////
+/// Clipping a triangle against all of the
+/// planes yields a convex polygon with at most
+/// 3 + TX_NUM_CLIP_PLANES vertices, which is
+/// split into this many triangles
+////////////////////////////////////////
+#define TX_MAX_CLIPPED_TRIANGLES (1 + TX_NUM_CLIP_PLANES)
+
+////////////////////////////////////////
+/// Returns the set of planes the vertex whose
+/// clip-space position is pos is outside of
+////////////////////////////////////////
+TX_FORCE_INLINE unsigned txComputeOutcode(TXvec4 pos, float guardBand)
+{
+    float w = pos[3];
+    float gw = guardBand * w;
+
+    unsigned outcode = 0;
+    if (pos[0] < -gw)
+        outcode |= TX_CLIP_LEFT;
+    if (pos[0] > gw)
+        outcode |= TX_CLIP_RIGHT;
+    if (pos[1] < -gw)
+        outcode |= TX_CLIP_BOTTOM;
+    if (pos[1] > gw)
+        outcode |= TX_CLIP_TOP;
+    if (pos[2] < -w)
+        outcode |= TX_CLIP_NEAR;
+    if (pos[2] > w)
+        outcode |= TX_CLIP_FAR;
+    return outcode;
+}
+
+////////////////////////////////////////
+/// Clips triangles[0] against the planes in the
+/// given set (see TX_CLIP_*) with the
+/// Sutherland-Hodgman algorithm. Clip-space positions,
+/// object-space positions and all attributes are
+/// interpolated linearly in clip-space.
+///
+/// Resulting triangles are stored in triangles, which
+/// must have room for TX_MAX_CLIPPED_TRIANGLES, and
+/// have the same winding order as the input.
+///
+/// Returns the number of resulting triangles
+////////////////////////////////////////
+int txClipTriangle(TXtriangle_t triangles[], unsigned planes, float guardBand);
+
+////////////////////////////////////////
+/// Clips the line whose clip-space endpoints
+/// are v0 and v1 against the planes in the
+/// given set (see TX_CLIP_*) with the
+/// Liang-Barsky algorithm. Endpoints are
+/// replaced with the clipped ones, and the
+/// parameters of the clipped endpoints along
+/// the original line are stored in t0 and t1
+/// (so that other attributes can be clipped too).
+///
+/// Returns false if nothing is left of the line
+////////////////////////////////////////
+bool txClipLine(TXvec4 v0, TXvec4 v1, unsigned planes, float guardBand, float* t0, float* t1);
+
 ////////////////////////////////////////
 #ifdef __cplusplus
 }
@@ -0,0 +1,97 @@
+// Copyright (C) 2023 saccharineboi
+
+#include "buffer.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+////////////////////////////////////////
+bool txCreateVertexBuffer(TXvertexBuffer_t* vertexBuffer,
+                          TXvec4* vertices[],
+                          int numVertices,
+                          enum TXvertexInfo vertexInfo)
+{
+    memset(vertexBuffer, 0, sizeof(TXvertexBuffer_t));
+
+    int numAttributes = txGetNumVertexAttributes(vertexInfo);
+    if (!numAttributes) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txCreateVertexBuffer: given VAO configuration (%d) is invalid", vertexInfo);
+        return false;
+    }
+    if (numVertices < 0)
+        numVertices = 0;
+
+    if (numVertices) {
+        vertexBuffer->data = (TXvec4*)malloc((unsigned)(numVertices * numAttributes) * sizeof(TXvec4));
+        if (!vertexBuffer->data) {
+            txOutputMessage(TX_ERROR, "[CursedGL] txCreateVertexBuffer: out of memory while copying %d vertices", numVertices);
+            return false;
+        }
+    }
+    vertexBuffer->numVertices = numVertices;
+    vertexBuffer->numAttributes = numAttributes;
+    vertexBuffer->vertexInfo = vertexInfo;
+
+    for (int i = 0; i < numVertices; ++i) {
+        TXvec4* dst = &vertexBuffer->data[i * numAttributes];
+        for (int j = 0; j < numAttributes; ++j)
+            txVec4Copy(dst[j], vertices[i][j]);
+    }
+
+    txComputeVertexBufferBounds(vertexBuffer);
+    return true;
+}
+
+////////////////////////////////////////
+void txComputeVertexBufferBounds(TXvertexBuffer_t* vertexBuffer)
+{
+    txVec4Set(vertexBuffer->boundsMin,  HUGE_VALF,  HUGE_VALF,  HUGE_VALF, 1.0f);
+    txVec4Set(vertexBuffer->boundsMax, -HUGE_VALF, -HUGE_VALF, -HUGE_VALF, 1.0f);
+
+    for (int i = 0; i < vertexBuffer->numVertices; ++i) {
+        float* pos = vertexBuffer->data[i * vertexBuffer->numAttributes];
+        for (int k = 0; k < 3; ++k) {
+            vertexBuffer->boundsMin[k] = fminf(vertexBuffer->boundsMin[k], pos[k]);
+            vertexBuffer->boundsMax[k] = fmaxf(vertexBuffer->boundsMax[k], pos[k]);
+        }
+    }
+}
+
+////////////////////////////////////////
+void txFreeVertexBuffer(TXvertexBuffer_t* vertexBuffer)
+{
+    free(vertexBuffer->data);
+    memset(vertexBuffer, 0, sizeof(TXvertexBuffer_t));
+}
+
+////////////////////////////////////////
+bool txCreateIndexBuffer(TXindexBuffer_t* indexBuffer,
+                         unsigned* indices,
+                         int numIndices)
+{
+    memset(indexBuffer, 0, sizeof(TXindexBuffer_t));
+
+    numIndices = numIndices < 0 ? 0 : numIndices - numIndices % 3;
+    if (numIndices) {
+        indexBuffer->indices = (unsigned*)malloc((unsigned)numIndices * sizeof(unsigned));
+        if (!indexBuffer->indices) {
+            txOutputMessage(TX_ERROR, "[CursedGL] txCreateIndexBuffer: out of memory while copying %d indices", numIndices);
+            return false;
+        }
+        memcpy(indexBuffer->indices, indices, (unsigned)numIndices * sizeof(unsigned));
+    }
+    indexBuffer->numIndices = numIndices;
+
+    for (int i = 0; i < numIndices; ++i)
+        if (indices[i] > indexBuffer->maxIndex)
+            indexBuffer->maxIndex = indices[i];
+    return true;
+}
+
+////////////////////////////////////////
+void txFreeIndexBuffer(TXindexBuffer_t* indexBuffer)
+{
+    free(indexBuffer->indices);
+    memset(indexBuffer, 0, sizeof(TXindexBuffer_t));
+}
@@ -0,0 +1,111 @@
+// Copyright (C) 2023 saccharineboi
+
+#include "commandqueue.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <semaphore.h>
+
+////////////////////////////////////////
+void txWaitSemaphore(sem_t* semaphore)
+{
+    while (sem_wait(semaphore) && errno == EINTR)
+        ;
+}
+
+////////////////////////////////////////
+bool txCreateCommandQueue(TXcommandQueue_t* queue, unsigned capacity)
+{
+    if (!capacity)
+        return false;
+
+    queue->commands = (struct TXcommand*)malloc(capacity * sizeof(struct TXcommand));
+    if (!queue->commands)
+        return false;
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->tail = 0;
+
+    if (sem_init(&queue->numCommands, 0, 0)) {
+        free(queue->commands);
+        queue->commands = NULL;
+        return false;
+    }
+    if (sem_init(&queue->numFreeSlots, 0, capacity)) {
+        sem_destroy(&queue->numCommands);
+        free(queue->commands);
+        queue->commands = NULL;
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+/// Stores a command into the slot at tail.
+/// The caller owns a free slot
+////////////////////////////////////////
+static void storeCommand(TXcommandQueue_t* queue, TXcommandCallback callback, void* userData)
+{
+    struct TXcommand* command = &queue->commands[queue->tail];
+    command->callback = callback;
+    command->userData = userData;
+
+    queue->tail = queue->tail + 1 < queue->capacity ? queue->tail + 1 : 0;
+    sem_post(&queue->numCommands);
+}
+
+////////////////////////////////////////
+void txPushCommand(TXcommandQueue_t* queue, TXcommandCallback callback, void* userData)
+{
+    txWaitSemaphore(&queue->numFreeSlots);
+    storeCommand(queue, callback, userData);
+}
+
+////////////////////////////////////////
+bool txTryPushCommand(TXcommandQueue_t* queue, TXcommandCallback callback, void* userData)
+{
+    if (sem_trywait(&queue->numFreeSlots))
+        return false;
+    storeCommand(queue, callback, userData);
+    return true;
+}
+
+////////////////////////////////////////
+/// Takes the command out of the slot at head.
+/// The caller owns a filled slot
+////////////////////////////////////////
+static void loadCommand(TXcommandQueue_t* queue, struct TXcommand* command)
+{
+    *command = queue->commands[queue->head];
+
+    queue->head = queue->head + 1 < queue->capacity ? queue->head + 1 : 0;
+    sem_post(&queue->numFreeSlots);
+}
+
+////////////////////////////////////////
+void txPopCommand(TXcommandQueue_t* queue, struct TXcommand* command)
+{
+    txWaitSemaphore(&queue->numCommands);
+    loadCommand(queue, command);
+}
+
+////////////////////////////////////////
+bool txTryPopCommand(TXcommandQueue_t* queue, struct TXcommand* command)
+{
+    if (sem_trywait(&queue->numCommands))
+        return false;
+    loadCommand(queue, command);
+    return true;
+}
+
+////////////////////////////////////////
+void txDestroyCommandQueue(TXcommandQueue_t* queue)
+{
+    free(queue->commands);
+    queue->commands = NULL;
+    queue->capacity = 0;
+
+    sem_destroy(&queue->numFreeSlots);
+    sem_destroy(&queue->numCommands);
+}
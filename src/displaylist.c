@@ -0,0 +1,410 @@
+// Copyright (C) 2023 saccharineboi
+
+#include "displaylist.h"
+#include "rasterizer.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+////////////////////////////////////////
+/// Triangles of a display list sharing
+/// the same VAO configuration
+////////////////////////////////////////
+struct TXlistCommand
+{
+    TXvertexBuffer_t vertexBuffer;
+    TXindexBuffer_t indexBuffer;
+};
+
+////////////////////////////////////////
+struct TXdisplayList
+{
+    struct TXlistCommand* commands;
+    int numCommands;
+    bool isUsed;
+};
+
+////////////////////////////////////////
+/// lists[i] is the display list named i + 1.
+/// Lists are shared by all threads, so
+/// listsMutex guards them and their names
+////////////////////////////////////////
+static struct TXdisplayList* lists;
+static unsigned numLists;
+static pthread_mutex_t listsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+////////////////////////////////////////
+/// Largest name given to a display list
+////////////////////////////////////////
+static unsigned lastListName;
+
+////////////////////////////////////////
+/// State of the list being compiled by
+/// this thread, so that draw calls of other
+/// threads aren't recorded into it.
+///
+/// vertices (with room for maxAttributes
+/// attributes) and indices collect the command
+/// that's currently being recorded; they are
+/// handed over to commands once a vertex with
+/// a different VAO configuration comes in
+////////////////////////////////////////
+static __thread struct {
+    bool isCompiling;
+    bool outOfMemory;
+    unsigned list;
+    enum TXlistMode mode;
+
+    struct TXlistCommand* commands;
+    int numCommands;
+    int maxCommands;
+
+    enum TXvertexInfo vertexInfo;
+    int numAttributes;
+    TXvec4* vertices;
+    int numVertices;
+    int maxAttributes;
+
+    unsigned* indices;
+    int numIndices;
+    int maxIndices;
+    unsigned maxIndex;
+} recorder;
+
+////////////////////////////////////////
+static void freeCommands(struct TXlistCommand* commands, int numCommands)
+{
+    for (int i = 0; i < numCommands; ++i) {
+        txFreeVertexBuffer(&commands[i].vertexBuffer);
+        txFreeIndexBuffer(&commands[i].indexBuffer);
+    }
+    free(commands);
+}
+
+////////////////////////////////////////
+/// Makes sure lists has room for the list
+/// named list. Returns false if out of memory.
+/// listsMutex MUST be locked
+////////////////////////////////////////
+static bool reserveList(unsigned list)
+{
+    if (list > lastListName)
+        lastListName = list;
+    if (list <= numLists)
+        return true;
+
+    unsigned newNumLists = numLists ? numLists : 64;
+    while (newNumLists < list)
+        newNumLists *= 2;
+
+    struct TXdisplayList* newLists = (struct TXdisplayList*)realloc(lists, newNumLists * sizeof(struct TXdisplayList));
+    if (!newLists)
+        return false;
+
+    memset(&newLists[numLists], 0, (newNumLists - numLists) * sizeof(struct TXdisplayList));
+    lists = newLists;
+    numLists = newNumLists;
+    return true;
+}
+
+////////////////////////////////////////
+/// Turns the triangles recorded so far into
+/// a command of the list being compiled
+////////////////////////////////////////
+static void flushRecordedCommand()
+{
+    if (!recorder.numIndices) {
+        recorder.numVertices = 0;
+        return;
+    }
+
+    if (recorder.numCommands == recorder.maxCommands) {
+        int maxCommands = recorder.maxCommands ? recorder.maxCommands * 2 : 8;
+        struct TXlistCommand* commands = (struct TXlistCommand*)realloc(recorder.commands,
+                                                                        (unsigned)maxCommands * sizeof(struct TXlistCommand));
+        if (!commands) {
+            recorder.outOfMemory = true;
+            return;
+        }
+        recorder.commands = commands;
+        recorder.maxCommands = maxCommands;
+    }
+
+    // Ownership of vertices and indices moves
+    // over to the command, shrunk to fit
+    struct TXlistCommand* command = &recorder.commands[recorder.numCommands++];
+
+    TXvec4* vertices = (TXvec4*)realloc(recorder.vertices,
+                                        (unsigned)(recorder.numVertices * recorder.numAttributes) * sizeof(TXvec4));
+    command->vertexBuffer.data = vertices ? vertices : recorder.vertices;
+    command->vertexBuffer.numVertices = recorder.numVertices;
+    command->vertexBuffer.numAttributes = recorder.numAttributes;
+    command->vertexBuffer.vertexInfo = recorder.vertexInfo;
+    txComputeVertexBufferBounds(&command->vertexBuffer);
+
+    unsigned* indices = (unsigned*)realloc(recorder.indices, (unsigned)recorder.numIndices * sizeof(unsigned));
+    command->indexBuffer.indices = indices ? indices : recorder.indices;
+    command->indexBuffer.numIndices = recorder.numIndices;
+    command->indexBuffer.maxIndex = recorder.maxIndex;
+
+    recorder.vertices = NULL;
+    recorder.numVertices = 0;
+    recorder.maxAttributes = 0;
+
+    recorder.indices = NULL;
+    recorder.numIndices = 0;
+    recorder.maxIndices = 0;
+    recorder.maxIndex = 0;
+}
+
+////////////////////////////////////////
+/// listsMutex MUST be locked
+////////////////////////////////////////
+static bool isList(unsigned list)
+{
+    return list && list <= numLists && lists[list - 1].isUsed;
+}
+
+////////////////////////////////////////
+unsigned txGenLists(int range)
+{
+    if (range <= 0)
+        return 0;
+
+    pthread_mutex_lock(&listsMutex);
+
+    // Names are never reused
+    unsigned first = lastListName + 1;
+    if (!reserveList(first + (unsigned)range - 1)) {
+        pthread_mutex_unlock(&listsMutex);
+        txOutputMessage(TX_ERROR, "[CursedGL] txGenLists: out of memory while generating %d lists", range);
+        return 0;
+    }
+    for (unsigned i = 0; i < (unsigned)range; ++i)
+        lists[first - 1 + i].isUsed = true;
+
+    pthread_mutex_unlock(&listsMutex);
+    return first;
+}
+
+////////////////////////////////////////
+void txNewList(unsigned list, enum TXlistMode mode)
+{
+    if (!list) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txNewList: 0 is not a valid display list name");
+        return;
+    }
+    if (recorder.isCompiling) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txNewList: display list %u is already being compiled", recorder.list);
+        return;
+    }
+
+    recorder.isCompiling = true;
+    recorder.outOfMemory = false;
+    recorder.list = list;
+    recorder.mode = mode;
+    recorder.numCommands = 0;
+    recorder.numVertices = 0;
+    recorder.numIndices = 0;
+    recorder.maxIndex = 0;
+}
+
+////////////////////////////////////////
+void txEndList()
+{
+    if (!recorder.isCompiling) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txEndList: no display list is being compiled");
+        return;
+    }
+    recorder.isCompiling = false;
+
+    flushRecordedCommand();
+
+    pthread_mutex_lock(&listsMutex);
+    if (recorder.outOfMemory || !reserveList(recorder.list)) {
+        pthread_mutex_unlock(&listsMutex);
+        txOutputMessage(TX_ERROR, "[CursedGL] txEndList: out of memory while compiling display list %u", recorder.list);
+        freeCommands(recorder.commands, recorder.numCommands);
+        free(recorder.vertices);
+        free(recorder.indices);
+        memset(&recorder, 0, sizeof(recorder));
+        return;
+    }
+
+    struct TXdisplayList* displayList = &lists[recorder.list - 1];
+    struct TXlistCommand* commands = displayList->commands;
+    int numCommands = displayList->numCommands;
+
+    displayList->commands = recorder.commands;
+    displayList->numCommands = recorder.numCommands;
+    displayList->isUsed = true;
+    pthread_mutex_unlock(&listsMutex);
+
+    freeCommands(commands, numCommands);
+
+    recorder.commands = NULL;
+    recorder.numCommands = 0;
+    recorder.maxCommands = 0;
+}
+
+////////////////////////////////////////
+void txCallList(unsigned list)
+{
+    // lists may grow while drawing, but the
+    // commands of list stay where they are
+    pthread_mutex_lock(&listsMutex);
+    struct TXlistCommand* commands = NULL;
+    int numCommands = 0;
+    if (isList(list)) {
+        commands = lists[list - 1].commands;
+        numCommands = lists[list - 1].numCommands;
+    }
+    pthread_mutex_unlock(&listsMutex);
+
+    for (int i = 0; i < numCommands; ++i)
+        txDrawVertexBuffer(&commands[i].vertexBuffer, &commands[i].indexBuffer);
+}
+
+////////////////////////////////////////
+void txDeleteLists(unsigned list, int range)
+{
+    pthread_mutex_lock(&listsMutex);
+    for (int i = 0; i < range; ++i) {
+        unsigned name = list + (unsigned)i;
+        if (!name || name > numLists)
+            continue;
+
+        struct TXdisplayList* displayList = &lists[name - 1];
+        freeCommands(displayList->commands, displayList->numCommands);
+        memset(displayList, 0, sizeof(struct TXdisplayList));
+    }
+    pthread_mutex_unlock(&listsMutex);
+}
+
+////////////////////////////////////////
+bool txIsList(unsigned list)
+{
+    pthread_mutex_lock(&listsMutex);
+    bool result = isList(list);
+    pthread_mutex_unlock(&listsMutex);
+    return result;
+}
+
+////////////////////////////////////////
+bool txIsCompilingList()
+{
+    return recorder.isCompiling;
+}
+
+////////////////////////////////////////
+enum TXlistMode txGetListMode()
+{
+    return recorder.mode;
+}
+
+////////////////////////////////////////
+unsigned txRecordVertex(enum TXvertexInfo vertexInfo, TXvec4 vertex[])
+{
+    if (recorder.outOfMemory)
+        return 0;
+
+    if (!txGetNumVertexAttributes(vertexInfo)) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txRecordVertex: given VAO configuration (%d) is invalid", vertexInfo);
+        return (unsigned)recorder.numVertices;
+    }
+
+    if (recorder.numVertices && vertexInfo != recorder.vertexInfo)
+        flushRecordedCommand();
+    recorder.vertexInfo = vertexInfo;
+    recorder.numAttributes = txGetNumVertexAttributes(vertexInfo);
+
+    int numAttributes = (recorder.numVertices + 1) * recorder.numAttributes;
+    if (numAttributes > recorder.maxAttributes) {
+        int maxAttributes = recorder.maxAttributes ? recorder.maxAttributes : 1024;
+        while (maxAttributes < numAttributes)
+            maxAttributes *= 2;
+
+        TXvec4* vertices = (TXvec4*)realloc(recorder.vertices, (unsigned)maxAttributes * sizeof(TXvec4));
+        if (!vertices) {
+            recorder.outOfMemory = true;
+            return 0;
+        }
+        recorder.vertices = vertices;
+        recorder.maxAttributes = maxAttributes;
+    }
+
+    TXvec4* dst = &recorder.vertices[recorder.numVertices * recorder.numAttributes];
+    for (int i = 0; i < recorder.numAttributes; ++i)
+        txVec4Copy(dst[i], vertex[i]);
+    return (unsigned)recorder.numVertices++;
+}
+
+////////////////////////////////////////
+/// Returns true if the triangle with the given
+/// homogeneous positions has zero area in
+/// object-space, and thus in screen-space.
+///
+/// Positions are divided by w first. Points at
+/// infinity (w of 0) have no such position, so
+/// triangles with one of them are kept
+////////////////////////////////////////
+static bool isDegenerate(TXvec4 p0, TXvec4 p1, TXvec4 p2)
+{
+    if (txFloatEquals(p0[3], 0.0f) || txFloatEquals(p1[3], 0.0f) || txFloatEquals(p2[3], 0.0f))
+        return false;
+
+    TXvec4 v0, v1, v2;
+    txVec4DivideByW(v0, p0);
+    txVec4DivideByW(v1, p1);
+    txVec4DivideByW(v2, p2);
+
+    TXvec3 e0, e1, n;
+    txVec3Sub(e0, v1, v0);
+    txVec3Sub(e1, v2, v0);
+    txVec3Cross(n, e0, e1);
+    return txVec3Dot(n, n) <= 0.0f;
+}
+
+////////////////////////////////////////
+void txRecordTriangle(unsigned i0, unsigned i1, unsigned i2)
+{
+    if (recorder.outOfMemory)
+        return;
+
+    // Vertices that weren't recorded
+    unsigned numVertices = (unsigned)recorder.numVertices;
+    if (i0 >= numVertices || i1 >= numVertices || i2 >= numVertices)
+        return;
+
+    // Triangles with zero area in object-space
+    // have zero area in screen-space as well
+    if (i0 == i1 || i1 == i2 || i2 == i0)
+        return;
+
+    if (isDegenerate(recorder.vertices[i0 * (unsigned)recorder.numAttributes],
+                     recorder.vertices[i1 * (unsigned)recorder.numAttributes],
+                     recorder.vertices[i2 * (unsigned)recorder.numAttributes]))
+        return;
+
+    if (recorder.numIndices + 3 > recorder.maxIndices) {
+        int maxIndices = recorder.maxIndices ? recorder.maxIndices * 2 : 768;
+        unsigned* indices = (unsigned*)realloc(recorder.indices, (unsigned)maxIndices * sizeof(unsigned));
+        if (!indices) {
+            recorder.outOfMemory = true;
+            return;
+        }
+        recorder.indices = indices;
+        recorder.maxIndices = maxIndices;
+    }
+
+    recorder.indices[recorder.numIndices++] = i0;
+    recorder.indices[recorder.numIndices++] = i1;
+    recorder.indices[recorder.numIndices++] = i2;
+
+    unsigned maxIndex = i0 > i1 ? i0 : i1;
+    maxIndex = maxIndex > i2 ? maxIndex : i2;
+    if (maxIndex > recorder.maxIndex)
+        recorder.maxIndex = maxIndex;
+}
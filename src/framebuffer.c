@@ -10,23 +10,40 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <math.h>
+
+////////////////////////////////////////
+/// See txEnableAsyncPresent in framebuffer.h.
+///
+/// framebuffer is the index of the framebuffer
+/// in framebuffers to present next, or -1 once
+/// the presenter thread took it over. isBusy
+/// stays true until it's presented
+////////////////////////////////////////
+struct TXpresenter
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    TXframebufferInfo_t* framebufferInfo;
+    TXappInfo_t* appInfo;
+    int framebuffer;
+    bool isBusy;
+    bool quit;
+};
 
 ////////////////////////////////////////
 bool txCompareDepth(const TXappInfo_t* appInfo, const TXframebufferInfo_t* framebufferInfo, float interpolatedDepth, float pixelDepth)
 {
     switch (framebufferInfo->depthFunc) {
         case TX_LESS:
-            return interpolatedDepth < pixelDepth;
         case TX_LEQUAL:
-            return interpolatedDepth <= pixelDepth;
         case TX_EQUAL:
-            return txFloatEquals(interpolatedDepth, pixelDepth);
         case TX_GEQUAL:
-            return interpolatedDepth >= pixelDepth;
         case TX_GREATER:
-            return interpolatedDepth > pixelDepth;
         case TX_NOTEQUAL:
-            return !txFloatEquals(interpolatedDepth, pixelDepth);
+            return txDepthFuncPasses(framebufferInfo->depthFunc, interpolatedDepth, pixelDepth);
         default:
             if (appInfo->messageCallback) {
                 appInfo->messageCallback(TX_WARNING, "[CursedGL] txCompareDepth: invalid value: %d", framebufferInfo->depthFunc);
@@ -93,7 +110,12 @@ void txGetEffectiveDims(const TXappInfo_t* appInfo, const TXframebufferInfo_t* f
 ////////////////////////////////////////
 bool txViewport(const TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInfo, int width, int height)
 {
+    // The presenter might still be
+    // reading one of the framebuffers
+    txWaitForPresent(framebufferInfo);
+
     if (!framebufferInfo->framebuffers[0] || !framebufferInfo->framebuffers[1] ||
+        !framebufferInfo->hiZ[0] || !framebufferInfo->hiZ[1] ||
         framebufferInfo->width != width || framebufferInfo->height != height) {
         framebufferInfo->width = width;
         framebufferInfo->height = height;
@@ -103,16 +125,33 @@ bool txViewport(const TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInfo
 
         free(framebufferInfo->framebuffers[0]);
         free(framebufferInfo->framebuffers[1]);
+        free(framebufferInfo->hiZ[0]);
+        free(framebufferInfo->hiZ[1]);
 
         framebufferInfo->framebuffers[0] = (TXpixel_t*)malloc((unsigned)(effectiveWidth * effectiveHeight) * sizeof(TXpixel_t));
         framebufferInfo->framebuffers[1] = (TXpixel_t*)malloc((unsigned)(effectiveWidth * effectiveHeight) * sizeof(TXpixel_t));
 
         framebufferInfo->raw_framebuffer = (uint32_t*)malloc((unsigned)(effectiveWidth * effectiveHeight) * sizeof(uint32_t));
 
-        if (!framebufferInfo->framebuffers[0] || !framebufferInfo->framebuffers[1] || !framebufferInfo->raw_framebuffer) {
+        framebufferInfo->hiZWidth  = (width  + TX_HIZ_TILE_SIZE - 1) / TX_HIZ_TILE_SIZE;
+        framebufferInfo->hiZHeight = (height + TX_HIZ_TILE_SIZE - 1) / TX_HIZ_TILE_SIZE;
+
+        int numHiZTiles = framebufferInfo->hiZWidth * framebufferInfo->hiZHeight;
+        framebufferInfo->hiZ[0] = (TXhiZTile_t*)malloc((unsigned)numHiZTiles * sizeof(TXhiZTile_t));
+        framebufferInfo->hiZ[1] = (TXhiZTile_t*)malloc((unsigned)numHiZTiles * sizeof(TXhiZTile_t));
+
+        if (!framebufferInfo->framebuffers[0] || !framebufferInfo->framebuffers[1] || !framebufferInfo->raw_framebuffer ||
+            !framebufferInfo->hiZ[0] || !framebufferInfo->hiZ[1]) {
             return false;
         }
 
+        // Depths are garbage until the first clear,
+        // so tiles mustn't reject anything until then
+        for (int i = 0; i < numHiZTiles; ++i) {
+            framebufferInfo->hiZ[0][i].minDepth = framebufferInfo->hiZ[1][i].minDepth = -HUGE_VALF;
+            framebufferInfo->hiZ[0][i].maxDepth = framebufferInfo->hiZ[1][i].maxDepth =  HUGE_VALF;
+        }
+
         framebufferInfo->currentFramebuffer = 0;
     }
     return true;
@@ -127,6 +166,14 @@ void txClear(TXframebufferInfo_t* framebufferInfo)
         if ((framebufferInfo->flags & TX_DEPTH_TEST) && (framebufferInfo->flags & TX_DEPTH_BIT))
             framebufferInfo->framebuffers[framebufferInfo->currentFramebuffer][i].depth = framebufferInfo->depthClear;
     }
+
+    TXhiZTile_t* hiZ = framebufferInfo->hiZ[framebufferInfo->currentFramebuffer];
+    if (hiZ && (framebufferInfo->flags & TX_DEPTH_TEST) && (framebufferInfo->flags & TX_DEPTH_BIT)) {
+        for (int i = 0; i < framebufferInfo->hiZWidth * framebufferInfo->hiZHeight; ++i) {
+            hiZ[i].minDepth = framebufferInfo->depthClear;
+            hiZ[i].maxDepth = framebufferInfo->depthClear;
+        }
+    }
 }
 
 ////////////////////////////////////////
@@ -174,17 +221,39 @@ bool txSetPixelInDisplayFramebuffer(TXframebufferInfo_t* framebufferInfo, int ro
 }
 
 ////////////////////////////////////////
-void txDrawFramebuffer(TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInfo, int offsetX, int offsetY, int limitX, int limitY)
+void txUpdateHiZTile(TXframebufferInfo_t* framebufferInfo, int row, int col)
 {
-    offsetX = offsetX;
-    offsetY = offsetY;
+    TXhiZTile_t* tile = txGetHiZTileFromCurrentFramebuffer(framebufferInfo, row, col);
+    if (!tile)
+        return;
 
-    limitX = limitX;
-    limitY = limitY;
+    int minRow = (row / TX_HIZ_TILE_SIZE) * TX_HIZ_TILE_SIZE;
+    int minCol = (col / TX_HIZ_TILE_SIZE) * TX_HIZ_TILE_SIZE;
+    int maxRow = minRow + TX_HIZ_TILE_SIZE < framebufferInfo->height ? minRow + TX_HIZ_TILE_SIZE : framebufferInfo->height;
+    int maxCol = minCol + TX_HIZ_TILE_SIZE < framebufferInfo->width  ? minCol + TX_HIZ_TILE_SIZE : framebufferInfo->width;
+
+    float minDepth =  HUGE_VALF;
+    float maxDepth = -HUGE_VALF;
+    for (int i = minRow; i < maxRow; ++i) {
+        TXpixel_t* pixels = &framebufferInfo->framebuffers[framebufferInfo->currentFramebuffer][i * framebufferInfo->width];
+        for (int j = minCol; j < maxCol; ++j) {
+            minDepth = fminf(minDepth, pixels[j].depth);
+            maxDepth = fmaxf(maxDepth, pixels[j].depth);
+        }
+    }
+    tile->minDepth = minDepth;
+    tile->maxDepth = maxDepth;
+}
 
+////////////////////////////////////////
+/// Converts framebuffers[framebuffer] to RGBA,
+/// blits it and renders it with notcurses
+////////////////////////////////////////
+static void presentFramebuffer(TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInfo, int framebuffer)
+{
     for (int i = 0; i < framebufferInfo->height; ++i) {
         for (int j = 0; j < framebufferInfo->width; ++j) {
-            TXpixel_t* currentPixel = txGetPixelFromCurrentFramebuffer(framebufferInfo, i, j);
+            TXpixel_t* currentPixel = &framebufferInfo->framebuffers[framebuffer][i * framebufferInfo->width + j];
 
             uint32_t u_r = (uint32_t)(currentPixel->color[0] * 255.0f);
             uint32_t u_g = (uint32_t)(currentPixel->color[1] * 255.0f);
@@ -200,10 +269,132 @@ void txDrawFramebuffer(TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInf
     notcurses_render(appInfo->ctx);
 }
 
+////////////////////////////////////////
+static void* presenterMain(void* arg)
+{
+    struct TXpresenter* presenter = (struct TXpresenter*)arg;
+
+    pthread_mutex_lock(&presenter->mutex);
+    for (;;) {
+        while (presenter->framebuffer < 0 && !presenter->quit)
+            pthread_cond_wait(&presenter->cond, &presenter->mutex);
+        if (presenter->framebuffer < 0)
+            break;
+
+        int framebuffer = presenter->framebuffer;
+        presenter->framebuffer = -1;
+        pthread_mutex_unlock(&presenter->mutex);
+
+        presentFramebuffer(presenter->appInfo, presenter->framebufferInfo, framebuffer);
+
+        pthread_mutex_lock(&presenter->mutex);
+        presenter->isBusy = false;
+        pthread_cond_broadcast(&presenter->cond);
+    }
+    pthread_mutex_unlock(&presenter->mutex);
+    return NULL;
+}
+
+////////////////////////////////////////
+void txDrawFramebuffer(TXappInfo_t* appInfo, TXframebufferInfo_t* framebufferInfo, int offsetX, int offsetY, int limitX, int limitY)
+{
+    offsetX = offsetX;
+    offsetY = offsetY;
+
+    limitX = limitX;
+    limitY = limitY;
+
+    struct TXpresenter* presenter = framebufferInfo->presenter;
+    if (!presenter) {
+        presentFramebuffer(appInfo, framebufferInfo, framebufferInfo->currentFramebuffer);
+        return;
+    }
+
+    pthread_mutex_lock(&presenter->mutex);
+    while (presenter->isBusy)
+        pthread_cond_wait(&presenter->cond, &presenter->mutex);
+
+    presenter->appInfo = appInfo;
+    presenter->framebuffer = framebufferInfo->currentFramebuffer;
+    presenter->isBusy = true;
+    pthread_cond_broadcast(&presenter->cond);
+    pthread_mutex_unlock(&presenter->mutex);
+}
+
+////////////////////////////////////////
+bool txEnableAsyncPresent(TXframebufferInfo_t* framebufferInfo)
+{
+    if (framebufferInfo->presenter)
+        return true;
+
+    struct TXpresenter* presenter = (struct TXpresenter*)malloc(sizeof(struct TXpresenter));
+    if (!presenter)
+        return false;
+
+    presenter->framebufferInfo = framebufferInfo;
+    presenter->appInfo = NULL;
+    presenter->framebuffer = -1;
+    presenter->isBusy = false;
+    presenter->quit = false;
+
+    pthread_mutex_init(&presenter->mutex, NULL);
+    pthread_cond_init(&presenter->cond, NULL);
+
+    if (pthread_create(&presenter->thread, NULL, presenterMain, presenter)) {
+        pthread_cond_destroy(&presenter->cond);
+        pthread_mutex_destroy(&presenter->mutex);
+        free(presenter);
+        return false;
+    }
+
+    framebufferInfo->presenter = presenter;
+    return true;
+}
+
+////////////////////////////////////////
+void txDisableAsyncPresent(TXframebufferInfo_t* framebufferInfo)
+{
+    struct TXpresenter* presenter = framebufferInfo->presenter;
+    if (!presenter)
+        return;
+
+    // A framebuffer that was handed over
+    // is still presented before quitting
+    txWaitForPresent(framebufferInfo);
+
+    pthread_mutex_lock(&presenter->mutex);
+    presenter->quit = true;
+    pthread_cond_broadcast(&presenter->cond);
+    pthread_mutex_unlock(&presenter->mutex);
+    pthread_join(presenter->thread, NULL);
+
+    pthread_cond_destroy(&presenter->cond);
+    pthread_mutex_destroy(&presenter->mutex);
+    free(presenter);
+    framebufferInfo->presenter = NULL;
+}
+
+////////////////////////////////////////
+void txWaitForPresent(TXframebufferInfo_t* framebufferInfo)
+{
+    struct TXpresenter* presenter = framebufferInfo->presenter;
+    if (!presenter)
+        return;
+
+    pthread_mutex_lock(&presenter->mutex);
+    while (presenter->isBusy)
+        pthread_cond_wait(&presenter->cond, &presenter->mutex);
+    pthread_mutex_unlock(&presenter->mutex);
+}
+
 ////////////////////////////////////////
 void txFreeFramebuffer(TXframebufferInfo_t* framebufferInfo)
 {
+    txDisableAsyncPresent(framebufferInfo);
+
     free(framebufferInfo->framebuffers[0]);
     free(framebufferInfo->framebuffers[1]);
     free(framebufferInfo->raw_framebuffer);
+    free(framebufferInfo->hiZ[0]);
+    free(framebufferInfo->hiZ[1]);
 }
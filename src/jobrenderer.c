@@ -0,0 +1,107 @@
+// Copyright (C) 2023 saccharineboi
+
+#include "jobrenderer.h"
+#include "error.h"
+
+#include <stdlib.h>
+
+////////////////////////////////////////
+bool txCreateJobRenderer(TXjobRenderer_t* renderer, int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = txGetNumCores();
+
+    renderer->jobs = NULL;
+    renderer->draw = NULL;
+    renderer->sceneData = NULL;
+    renderer->numContexts = 0;
+
+    renderer->contexts = (TXcontext_t**)calloc((unsigned)numThreads, sizeof(TXcontext_t*));
+    if (!renderer->contexts) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txCreateJobRenderer: out of memory");
+        return false;
+    }
+
+    // The calling thread works on jobs too
+    if (!txCreateThreadPool(&renderer->pool, numThreads - 1)) {
+        free(renderer->contexts);
+        txOutputMessage(TX_ERROR, "[CursedGL] txCreateJobRenderer: couldn't create %d worker threads", numThreads - 1);
+        return false;
+    }
+
+    for (; renderer->numContexts < numThreads; ++renderer->numContexts) {
+        renderer->contexts[renderer->numContexts] = txCreateContext(NULL);
+        if (!renderer->contexts[renderer->numContexts]) {
+            txDestroyJobRenderer(renderer);
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////
+/// Renders a job with the context
+/// of the thread that took it
+////////////////////////////////////////
+static void renderJob(void* userData, int jobIndex, int threadIndex)
+{
+    TXjobRenderer_t* renderer = (TXjobRenderer_t*)userData;
+    TXrenderJob_t* job = &renderer->jobs[jobIndex];
+
+    txMakeContextCurrent(renderer->contexts[threadIndex]);
+    txBindFramebuffer(job->framebufferInfo);
+    txResetState();
+
+    txSetProjectionMatrix(job->projectionMatrix);
+    txSetModelViewMatrix(job->modelViewMatrix);
+    txSetNormalMatrix(job->normalMatrix);
+
+    renderer->draw(job, renderer->sceneData);
+
+    // txResetState keeps these modes, so they're
+    // turned off for the next job on this context.
+    // Either way the framebuffer has to be complete
+    // before txRenderJobs returns
+    txDisableRenderThread();
+    txDisableTiledRendering();
+    txDisableVisibilityBuffer();
+    txFinish();
+}
+
+////////////////////////////////////////
+void txRenderJobs(TXjobRenderer_t* renderer,
+                  TXrenderJob_t jobs[],
+                  int numJobs,
+                  TXrenderJobCallback draw,
+                  void* sceneData)
+{
+    if (numJobs <= 0 || !draw)
+        return;
+
+    renderer->jobs = jobs;
+    renderer->draw = draw;
+    renderer->sceneData = sceneData;
+
+    // Jobs the calling thread takes
+    // make its context current
+    TXcontext_t* context = txGetCurrentContext();
+    txRunJobs(&renderer->pool, renderJob, renderer, numJobs);
+    txMakeContextCurrent(context);
+
+    renderer->jobs = NULL;
+    renderer->draw = NULL;
+    renderer->sceneData = NULL;
+}
+
+////////////////////////////////////////
+void txDestroyJobRenderer(TXjobRenderer_t* renderer)
+{
+    txDestroyThreadPool(&renderer->pool);
+
+    for (int i = 0; i < renderer->numContexts; ++i)
+        txDestroyContext(renderer->contexts[i]);
+    free(renderer->contexts);
+
+    renderer->contexts = NULL;
+    renderer->numContexts = 0;
+}
@@ -1,146 +1,411 @@
 // Copyright (C) 2023 saccharineboi
 
 #include "rasterizer.h"
+#include "threadpool.h"
+#include "commandqueue.h"
+#include "span.h"
+#include "displaylist.h"
 #include "error.h"
 
 #include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <notcurses/notcurses.h>
 
 ////////////////////////////////////////
-/// This is the color that will be used
-/// while rendering objects in
-/// TX_UNLIT mode
+/// A client-side vertex array
+/// (see txVertexPointer)
 ////////////////////////////////////////
-static TXvec4 rasterColor = TX_VEC4_ONE;
+struct TXclientArray {
+    const unsigned char* pointer;
+    size_t stride;
+    int size;
+    enum TXdataType type;
+    bool enabled;
+};
 
 ////////////////////////////////////////
-//////////// MATRIX STACKS /////////////
+/// Post-transform vertex buffer shared by
+/// all draw calls, grown on demand.
+///
+/// stamps[i] == stamp iff vertices[i] was
+/// shaded during the current draw call, which
+/// is how txDrawIndexedTriangles shades each
+/// vertex it references exactly once
+////////////////////////////////////////
+struct TXvertexCache {
+    struct TXshadedVertex* vertices;
+    unsigned* stamps;
+    int maxVertices;
+    unsigned stamp;
+};
+
+////////////////////////////////////////
+/// State set through the API. Every command
+/// buffer has its own copy, so that threads
+/// recording them don't share any of it
+/// (see txBeginCommandBuffer)
+////////////////////////////////////////
+struct TXrasterState {
+    // This is the color that will be used
+    // while rendering objects in TX_UNLIT mode
+    TXvec4 rasterColor;
+
+    TXmat4 projectionMatrixStack[TX_PROJECTION_MATRIX_STACK_SIZE];
+    int currentProjectionMatrix;
+
+    TXmat4 modelViewMatrixStack[TX_MODELVIEW_MATRIX_STACK_SIZE];
+    int currentModelViewMatrix;
+
+    TXmat4 normalMatrixStack[TX_NORMAL_MATRIX_STACK_SIZE];
+    int currentNormalMatrix;
+
+    TXmat4 textureMatrixStack[TX_TEXTURE_MATRIX_STACK_SIZE];
+    int currentTextureMatrix;
+
+    TXmat4 lightMatrixStack[TX_LIGHT_MATRIX_STACK_SIZE];
+    int currentLightMatrix;
+
+    int matrixMode;
+
+    // See the comments above txSetWidthMultiplier
+    // and txSetGuardBand in rasterizer.h
+    float widthMultiplier;
+    float guardBand;
+
+    // See enum TXcullFace, enum TXwindOrder,
+    // enum TXcullMode and enum TXshadeModel
+    // in rasterizer.h
+    int cullFace;
+    int windOrder;
+    enum TXcullMode cullMode;
+    int shadeModel;
+
+    // See txColorMask in rasterizer.h
+    bool colorMask;
+
+    // See txBeginQuery in rasterizer.h
+    struct {
+        TXquery_t* query;
+        enum TXqueryMode mode;
+    } activeQuery;
+
+    struct TXclientArray clientArrays[TX_NUM_CLIENT_STATES];
+    struct TXvertexCache vertexCache;
+
+    // Context the state belongs to
+    TXcontext_t* context;
+
+    // Batch the triangles are recorded into
+    // while a command buffer is being recorded
+    // (see txBeginCommandBuffer), NULL otherwise
+    struct TXtriangleBatch* recordedBatch;
+};
+
+////////////////////////////////////////
+/// Initial state of every context
+////////////////////////////////////////
+#define TX_INITIAL_RASTER_STATE(owner) {                \
+    .rasterColor = TX_VEC4_ONE,                         \
+    .projectionMatrixStack = { TX_MAT4_IDENTITY },      \
+    .modelViewMatrixStack = { TX_MAT4_IDENTITY },       \
+    .normalMatrixStack = { TX_MAT4_IDENTITY },          \
+    .textureMatrixStack = { TX_MAT4_IDENTITY },         \
+    .lightMatrixStack = { TX_MAT4_IDENTITY },           \
+    .matrixMode = TX_MODELVIEW,                         \
+    .widthMultiplier = 2.0f,                            \
+    .guardBand = TX_DEFAULT_GUARD_BAND,                 \
+    .cullFace = TX_BACK,                                \
+    .windOrder = TX_CCW,                                \
+    .cullMode = TX_CULL_IN_SCREEN_SPACE,                \
+    .shadeModel = TX_UNLIT,                             \
+    .colorMask = true,                                  \
+    .context = (owner)                                  \
+}
+
+////////////////////////////////////////
+/// Set-up triangles waiting to be rendered
+/// into the framebuffer of context
 ////////////////////////////////////////
+struct TXtriangleBatch {
+    struct TXrasterTriangle* triangles;
+    int numTriangles;
+    int maxTriangles;
+
+    TXcontext_t* context;
+};
+
+////////////////////////////////////////
+/// See TXcontext_t in rasterizer.h
+////////////////////////////////////////
+struct TXcontext {
+    // State of the threads the context is
+    // current on, unless they're recording
+    // a command buffer
+    struct TXrasterState state;
+
+    // NULL if rendering to the
+    // default framebuffer
+    TXframebufferInfo_t* framebufferInfo;
+
+    // See txEnableVisibilityBuffer in rasterizer.h.
+    //
+    // ids[y * width + x] is the id of the triangle
+    // that pixel (x, y) is shaded with, or 0 if
+    // no triangle has been recorded there since
+    // the last resolve
+    struct {
+        bool enabled;
+        unsigned* ids;
+        int width;
+        int height;
+    } visibilityBuffer;
+
+    // See txEnableTiledRendering in rasterizer.h
+    struct {
+        bool enabled;
+        TXthreadPool_t pool;
 
+        // Triangles submitted since the last txFlush,
+        // which the visibility buffer and the render
+        // thread use as well
+        struct TXtriangleBatch batch;
+
+        // Bins are stored back to back: triangles
+        // of tile t are binIndices[binOffsets[t]]
+        // to binIndices[binOffsets[t + 1] - 1],
+        // in submission order
+        int* binOffsets;
+        int* binIndices;
+        int maxTiles;
+        int maxBinIndices;
+
+        int numTilesX;
+        int numTilesY;
+    } tiler;
+
+    // See txEnableRenderThread in rasterizer.h.
+    //
+    // Flushed batches go to the render thread
+    // through commands and come back through
+    // freeBatches once rendered, so that their
+    // triangle arrays are reused
+    struct {
+        bool enabled;
+        pthread_t thread;
+
+        TXcommandQueue_t commands;
+        TXcommandQueue_t freeBatches;
+        struct TXtriangleBatch* batches;
+
+        // Counts the frames that can still be
+        // submitted before txSubmitFrame blocks
+        sem_t frameSlots;
+
+        // Posted when the render thread
+        // reaches the fence of txFinish
+        sem_t finished;
+    } renderThread;
+
+    // Number of batches of triangles txFlush
+    // submitted and number of them rendered so
+    // far, which the render thread writes. See
+    // txIsQueryResultAvailable
+    unsigned numFlushes;
+    unsigned numRenderedBatches;
+};
+
+////////////////////////////////////////
+/// Context of every thread that hasn't
+/// made another one current
 ////////////////////////////////////////
-static TXmat4 projectionMatrixStack[TX_PROJECTION_MATRIX_STACK_SIZE] = { TX_MAT4_IDENTITY };
-static int currentProjectionMatrix;
+static TXcontext_t defaultContext = {
+    .state = TX_INITIAL_RASTER_STATE(&defaultContext),
+    .tiler.batch.context = &defaultContext
+};
 
 ////////////////////////////////////////
-static TXmat4 modelViewMatrixStack[TX_MODELVIEW_MATRIX_STACK_SIZE] = { TX_MAT4_IDENTITY };
-static int currentModelViewMatrix;
+/// State the API calls of this thread read
+/// and write: the state of its current context,
+/// or of a command buffer between
+/// txBeginCommandBuffer and txEndCommandBuffer
+////////////////////////////////////////
+static __thread struct TXrasterState* currentState = &defaultContext.state;
 
 ////////////////////////////////////////
-static TXmat4 normalMatrixStack[TX_NORMAL_MATRIX_STACK_SIZE] = { TX_MAT4_IDENTITY };
-static int currentNormalMatrix;
+/// Following functions return the size, the
+/// pixels, the depth state and the culling
+/// state of the framebuffer context renders to
+////////////////////////////////////////
+TX_FORCE_INLINE int getFramebufferWidth(const TXcontext_t* context)
+{
+    return context->framebufferInfo ? context->framebufferInfo->width : txGetFramebufferWidth();
+}
 
 ////////////////////////////////////////
-static TXmat4 textureMatrixStack[TX_TEXTURE_MATRIX_STACK_SIZE] = { TX_MAT4_IDENTITY };
-static int currentTextureMatrix;
+TX_FORCE_INLINE int getFramebufferHeight(const TXcontext_t* context)
+{
+    return context->framebufferInfo ? context->framebufferInfo->height : txGetFramebufferHeight();
+}
 
 ////////////////////////////////////////
-static TXmat4 lightMatrixStack[TX_LIGHT_MATRIX_STACK_SIZE] = { TX_MAT4_IDENTITY };
-static int currentLightMatrix;
+TX_FORCE_INLINE TXpixel_t* getPixel(const TXcontext_t* context, int row, int col)
+{
+    const TXframebufferInfo_t* framebufferInfo = context->framebufferInfo;
+    if (!framebufferInfo)
+        return txGetPixelFromBackFramebuffer(row, col);
+    return &framebufferInfo->framebuffers[framebufferInfo->currentFramebuffer][row * framebufferInfo->width + col];
+}
 
 ////////////////////////////////////////
-/// See the comment above txSetWidthMultiplier
-/// function in rasterizer.h
+TX_FORCE_INLINE bool isDepthTestEnabled(const TXcontext_t* context)
+{
+    return context->framebufferInfo ? (context->framebufferInfo->flags & TX_DEPTH_TEST) != 0 : txIsDepthTestEnabled();
+}
+
 ////////////////////////////////////////
-static float widthMultiplier = 2.0f;
+TX_FORCE_INLINE bool getDepthMask(const TXcontext_t* context)
+{
+    return context->framebufferInfo ? context->framebufferInfo->depthMask : txGetDepthMask();
+}
 
 ////////////////////////////////////////
-/// See enum TXcullFace in rasterizer.h
+/// The default framebuffer only exposes its
+/// depth function through txCompareDepth, so
+/// it's recovered from the results for depths
+/// below, equal to and above the stored one
 ////////////////////////////////////////
-static int cullFace = TX_BACK;
+static enum TXdepthFunc getDefaultDepthFunc()
+{
+    bool less    = txCompareDepth(0.0f, 1.0f);
+    bool equal   = txCompareDepth(1.0f, 1.0f);
+    bool greater = txCompareDepth(1.0f, 0.0f);
+
+    if (less && greater)
+        return TX_NOTEQUAL;
+    if (less)
+        return equal ? TX_LEQUAL : TX_LESS;
+    if (greater)
+        return equal ? TX_GEQUAL : TX_GREATER;
+    return TX_EQUAL;
+}
 
 ////////////////////////////////////////
-/// See enum TXwindOrder in rasterizer.h
+TX_FORCE_INLINE enum TXdepthFunc getDepthFunc(const TXcontext_t* context)
+{
+    return context->framebufferInfo ? context->framebufferInfo->depthFunc : getDefaultDepthFunc();
+}
+
 ////////////////////////////////////////
-static int windOrder = TX_CCW;
+TX_FORCE_INLINE bool passesDepthTest(const TXcontext_t* context, float depth, float pixelDepth)
+{
+    if (!context->framebufferInfo)
+        return txCompareDepth(depth, pixelDepth);
+    return txDepthFuncPasses(context->framebufferInfo->depthFunc, depth, pixelDepth);
+}
 
 ////////////////////////////////////////
-static int matrixMode = TX_MODELVIEW;
+TX_FORCE_INLINE bool isCullingEnabled(const TXcontext_t* context)
+{
+    return context->framebufferInfo ? (context->framebufferInfo->flags & TX_CULL_FACE) != 0 : txIsCullingEnabled();
+}
 
 ////////////////////////////////////////
-/// See enum TXshadeModel in rasterizer.h
+/// Same as txConvertToWindowSpace for a
+/// framebuffer of the given size
 ////////////////////////////////////////
-static int shadeModel = TX_UNLIT;
+TX_FORCE_INLINE void convertToWindowSpace(TXvec3 dst, TXvec4 src, float fbWidth, float fbHeight)
+{
+    TXvec4 ndcVec;
+    txVec4DivideByW(ndcVec, src);
+
+    dst[0] = (fbWidth  / 2.0f) * ( ndcVec[0] + 1.0f);
+    dst[1] = (fbHeight / 2.0f) * (-ndcVec[1] + 1.0f);
+    dst[2] = (ndcVec[2] + 1.0f) / 2.0f;
+}
 
 ////////////////////////////////////////
 void txShadeModel(enum TXshadeModel model)
 {
-    shadeModel = model;
+    currentState->shadeModel = model;
 }
 
 ////////////////////////////////////////
 enum TXshadeModel txGetShadeModel()
 {
-    return shadeModel;
+    return currentState->shadeModel;
 }
 
 ////////////////////////////////////////
 void txMatrixMode(enum TXmatrixType type)
 {
-    matrixMode = type;
+    currentState->matrixMode = type;
 }
 
 ////////////////////////////////////////
 enum TXmatrixType txGetMatrixMode()
 {
-    return matrixMode;
+    return currentState->matrixMode;
 }
 
 ////////////////////////////////////////
 bool txPushMatrix()
 {
-    switch (matrixMode) {
+    switch (currentState->matrixMode) {
         case TX_PROJECTION:
-            if (currentProjectionMatrix < TX_PROJECTION_MATRIX_STACK_SIZE - 1) {
-                ++currentProjectionMatrix;
-                txMat4Copy(projectionMatrixStack[currentProjectionMatrix],
-                           projectionMatrixStack[currentProjectionMatrix - 1]);
+            if (currentState->currentProjectionMatrix < TX_PROJECTION_MATRIX_STACK_SIZE - 1) {
+                ++currentState->currentProjectionMatrix;
+                txMat4Copy(currentState->projectionMatrixStack[currentState->currentProjectionMatrix],
+                           currentState->projectionMatrixStack[currentState->currentProjectionMatrix - 1]);
                 return true;
             } else {
                 txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: projection matrix stack is full");
             }
             break;
         case TX_MODELVIEW:
-            if (currentModelViewMatrix < TX_MODELVIEW_MATRIX_STACK_SIZE - 1) {
-                ++currentModelViewMatrix;
-                txMat4Copy(modelViewMatrixStack[currentModelViewMatrix],
-                           modelViewMatrixStack[currentModelViewMatrix - 1]);
+            if (currentState->currentModelViewMatrix < TX_MODELVIEW_MATRIX_STACK_SIZE - 1) {
+                ++currentState->currentModelViewMatrix;
+                txMat4Copy(currentState->modelViewMatrixStack[currentState->currentModelViewMatrix],
+                           currentState->modelViewMatrixStack[currentState->currentModelViewMatrix - 1]);
                 return true;
             } else {
                 txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: modelview matrix stack is full");
             }
             break;
         case TX_NORMAL:
-            if (currentNormalMatrix < TX_NORMAL_MATRIX_STACK_SIZE - 1) {
-                ++currentNormalMatrix;
-                txMat4Copy(normalMatrixStack[currentNormalMatrix],
-                           normalMatrixStack[currentNormalMatrix - 1]);
+            if (currentState->currentNormalMatrix < TX_NORMAL_MATRIX_STACK_SIZE - 1) {
+                ++currentState->currentNormalMatrix;
+                txMat4Copy(currentState->normalMatrixStack[currentState->currentNormalMatrix],
+                           currentState->normalMatrixStack[currentState->currentNormalMatrix - 1]);
                 return true;
             } else {
                 txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: normal matrix stack is full");
             }
             break;
         case TX_TEXTURE:
-            if (currentTextureMatrix < TX_TEXTURE_MATRIX_STACK_SIZE - 1) {
-                ++currentTextureMatrix;
-                txMat4Copy(textureMatrixStack[currentTextureMatrix],
-                           textureMatrixStack[currentTextureMatrix - 1]);
+            if (currentState->currentTextureMatrix < TX_TEXTURE_MATRIX_STACK_SIZE - 1) {
+                ++currentState->currentTextureMatrix;
+                txMat4Copy(currentState->textureMatrixStack[currentState->currentTextureMatrix],
+                           currentState->textureMatrixStack[currentState->currentTextureMatrix - 1]);
                 return true;
             } else {
                 txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: texture matrix stack is full");
             }
             break;
         case TX_LIGHT:
-            if (currentLightMatrix < TX_LIGHT_MATRIX_STACK_SIZE - 1) {
-                ++currentLightMatrix;
-                txMat4Copy(lightMatrixStack[currentLightMatrix],
-                           lightMatrixStack[currentLightMatrix - 1]);
+            if (currentState->currentLightMatrix < TX_LIGHT_MATRIX_STACK_SIZE - 1) {
+                ++currentState->currentLightMatrix;
+                txMat4Copy(currentState->lightMatrixStack[currentState->currentLightMatrix],
+                           currentState->lightMatrixStack[currentState->currentLightMatrix - 1]);
                 return true;
             } else {
                 txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: light matrix stack is full");
             }
             break;
         default:
-            txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: %d is invalid matrix mode", matrixMode);
+            txOutputMessage(TX_WARNING, "[CursedGL] txPushMatrix: %d is invalid matrix mode", currentState->matrixMode);
             break;
     }
     return false;
@@ -149,38 +414,38 @@ bool txPushMatrix()
 ////////////////////////////////////////
 bool txPopMatrix()
 {
-    switch (matrixMode) {
+    switch (currentState->matrixMode) {
         case TX_PROJECTION:
-            if (currentProjectionMatrix > 0) {
-                --currentProjectionMatrix;
+            if (currentState->currentProjectionMatrix > 0) {
+                --currentState->currentProjectionMatrix;
                 return true;
             }
             txOutputMessage(TX_WARNING, "[CursedGL] txPopMatrix: projection matrix stack is empty");
             break;
         case TX_MODELVIEW:
-            if (currentModelViewMatrix > 0) {
-                --currentModelViewMatrix;
+            if (currentState->currentModelViewMatrix > 0) {
+                --currentState->currentModelViewMatrix;
                 return true;
             }
             txOutputMessage(TX_WARNING, "[CursedGL] txPopMatrix: modelview matrix stack is empty");
             break;
         case TX_NORMAL:
-            if (currentNormalMatrix > 0) {
-                --currentNormalMatrix;
+            if (currentState->currentNormalMatrix > 0) {
+                --currentState->currentNormalMatrix;
                 return true;
             }
             txOutputMessage(TX_WARNING, "[CursedGL] txPopMatrix: normal matrix stack is empty");
             break;
         case TX_TEXTURE:
-            if (currentTextureMatrix > 0) {
-                --currentTextureMatrix;
+            if (currentState->currentTextureMatrix > 0) {
+                --currentState->currentTextureMatrix;
                 return true;
             }
             txOutputMessage(TX_WARNING, "[CursedGL] txPopMatrix: texture matrix stack is empty");
             break;
         case TX_LIGHT:
-            if (currentLightMatrix > 0) {
-                --currentLightMatrix;
+            if (currentState->currentLightMatrix > 0) {
+                --currentState->currentLightMatrix;
                 return true;
             }
             txOutputMessage(TX_WARNING, "[CursedGL] txPopMatrix: light matrix stack is empty");
@@ -192,73 +457,85 @@ bool txPopMatrix()
 ////////////////////////////////////////
 float txGetWidthMultiplier()
 {
-    return widthMultiplier;
+    return currentState->widthMultiplier;
 }
 
 ////////////////////////////////////////
 void txSetWidthMultiplier(float x)
 {
-    widthMultiplier = x;
+    currentState->widthMultiplier = x;
+}
+
+////////////////////////////////////////
+float txGetGuardBand()
+{
+    return currentState->guardBand;
+}
+
+////////////////////////////////////////
+void txSetGuardBand(float x)
+{
+    currentState->guardBand = x < 1.0f ? 1.0f : x;
 }
 
 ////////////////////////////////////////
 void txSetProjectionMatrix(TXmat4 matrix)
 {
-    txMat4Copy(projectionMatrixStack[currentProjectionMatrix], matrix);
+    txMat4Copy(currentState->projectionMatrixStack[currentState->currentProjectionMatrix], matrix);
 }
 
 ////////////////////////////////////////
 float* txGetProjectionMatrix()
 {
-    return projectionMatrixStack[currentProjectionMatrix];
+    return currentState->projectionMatrixStack[currentState->currentProjectionMatrix];
 }
 
 ////////////////////////////////////////
 void txSetModelViewMatrix(TXmat4 matrix)
 {
-    txMat4Copy(modelViewMatrixStack[currentModelViewMatrix], matrix);
+    txMat4Copy(currentState->modelViewMatrixStack[currentState->currentModelViewMatrix], matrix);
 }
 
 ////////////////////////////////////////
 float* txGetModelViewMatrix()
 {
-    return modelViewMatrixStack[currentModelViewMatrix];
+    return currentState->modelViewMatrixStack[currentState->currentModelViewMatrix];
 }
 
 ////////////////////////////////////////
 void txSetNormalMatrix(TXmat4 matrix)
 {
-    txMat4Copy(normalMatrixStack[currentNormalMatrix], matrix);
+    txMat4Copy(currentState->normalMatrixStack[currentState->currentNormalMatrix], matrix);
 }
 
 ////////////////////////////////////////
 float* txGetNormalMatrix()
 {
-    return normalMatrixStack[currentNormalMatrix];
+    return currentState->normalMatrixStack[currentState->currentNormalMatrix];
 }
 
 ////////////////////////////////////////
 void txSetTextureMatrix(TXmat4 matrix)
 {
-    txMat4Copy(textureMatrixStack[currentTextureMatrix], matrix);
+    txMat4Copy(currentState->textureMatrixStack[currentState->currentTextureMatrix], matrix);
 }
 
 ////////////////////////////////////////
 float* txGetTextureMatrix()
 {
-    return textureMatrixStack[currentTextureMatrix];
+    return currentState->textureMatrixStack[currentState->currentTextureMatrix];
 }
 
 ////////////////////////////////////////
 void txSetLightMatrix(TXmat4 matrix)
 {
-    txMat4Copy(lightMatrixStack[currentLightMatrix], matrix);
+    txMat4Copy(currentState->lightMatrixStack[currentState->currentLightMatrix], matrix);
 }
 
 ////////////////////////////////////////
 float* txGetLightMatrix()
 {
-    return lightMatrixStack[currentLightMatrix];
+    return currentState->lightMatrixStack[currentState->currentLightMatrix];
 }
 
 ////////////////////////////////////////
@@ -267,9 +544,9 @@ void txPerspective(float fovy,
                    float near,
                    float far)
 {
-    txGenPerspectiveProjectionMatrix(projectionMatrixStack[currentProjectionMatrix],
+    txGenPerspectiveProjectionMatrix(currentState->projectionMatrixStack[currentState->currentProjectionMatrix],
                                      fovy,
-                                     aspectRatio / widthMultiplier,
+                                     aspectRatio / currentState->widthMultiplier,
                                      near,
                                      far);
 }
@@ -280,8 +557,8 @@ void txOrtho(float width,
              float near,
              float far)
 {
-    txGenOrthographicProjectionMatrix(projectionMatrixStack[currentProjectionMatrix],
-                                      width * widthMultiplier,
+    txGenOrthographicProjectionMatrix(currentState->projectionMatrixStack[currentState->currentProjectionMatrix],
+                                      width * currentState->widthMultiplier,
                                       height,
                                       near,
                                       far);
@@ -290,75 +567,286 @@ void txOrtho(float width,
 ////////////////////////////////////////
 void txColor4fv(TXvec4 color)
 {
-    txVec4Copy(rasterColor, color);
+    txVec4Copy(currentState->rasterColor, color);
 }
 
 ////////////////////////////////////////
 void txColor4f(float r, float g, float b, float a)
 {
-    rasterColor[0] = r;
-    rasterColor[1] = g;
-    rasterColor[2] = b;
-    rasterColor[3] = a;
+    currentState->rasterColor[0] = r;
+    currentState->rasterColor[1] = g;
+    currentState->rasterColor[2] = b;
+    currentState->rasterColor[3] = a;
 }
 
 ////////////////////////////////////////
 void txGetColor4fv(TXvec4 color)
 {
-    txVec4Copy(color, rasterColor);
+    txVec4Copy(color, currentState->rasterColor);
 }
 
 ////////////////////////////////////////
 void txGetColor4f(float* r, float* g, float* b, float* a)
 {
-    *r = rasterColor[0];
-    *g = rasterColor[1];
-    *b = rasterColor[2];
-    *a = rasterColor[3];
+    *r = currentState->rasterColor[0];
+    *g = currentState->rasterColor[1];
+    *b = currentState->rasterColor[2];
+    *a = currentState->rasterColor[3];
 }
 
 ////////////////////////////////////////
 float* txGetColorPtr()
 {
-    return rasterColor;
+    return currentState->rasterColor;
 }
 
 ////////////////////////////////////////
 void txCullFace(enum TXcullFace face)
 {
-    cullFace = face;
+    currentState->cullFace = face;
 }
 
 ////////////////////////////////////////
 enum TXcullFace txGetCullFace()
 {
-    return cullFace;
+    return currentState->cullFace;
+}
+
+////////////////////////////////////////
+void txCullMode(enum TXcullMode mode)
+{
+    currentState->cullMode = mode;
+}
+
+////////////////////////////////////////
+enum TXcullMode txGetCullMode()
+{
+    return currentState->cullMode;
+}
+
+////////////////////////////////////////
+void txColorMask(bool mask)
+{
+    currentState->colorMask = mask;
+}
+
+////////////////////////////////////////
+bool txGetColorMask()
+{
+    return currentState->colorMask;
 }
 
 ////////////////////////////////////////
 void txFrontFace(enum TXwindOrder frontFace)
 {
-    windOrder = frontFace;
+    currentState->windOrder = frontFace;
 }
 
 ////////////////////////////////////////
 enum TXwindOrder txGetFrontFace()
 {
-    return windOrder;
+    return currentState->windOrder;
 }
 
 ////////////////////////////////////////
-/// A single invocation of this function
-/// corresponds to 3 invocations of a vertex
-/// shader for a given triangle in a
-/// typical hardware-accelerated graphics pipeline.
+/// Output of the vertex shader for a single
+/// vertex, aka, a post-transform vertex.
+///
+/// Draw calls shade each of their vertices
+/// once and assemble triangles from these,
+/// so that vertices shared between triangles
+/// (strips, fans, quads, indexed meshes)
+/// aren't transformed over and over again.
+///
+/// windowPos and zValue are only valid if
+/// outcode is 0, i.e. if the vertex is
+/// inside the guard band
+////////////////////////////////////////
+struct TXshadedVertex {
+    TXvec4 clipPos;
+    TXvec4 viewPos;
+    TXvec4 color;
+    TXvec4 normal;
+    TXvec3 windowPos;
+    float zValue;
+    unsigned outcode;
+};
+
+////////////////////////////////////////
+struct TXrasterTriangle;
+
+////////////////////////////////////////
+/// Rasterizes the block [x0, x1] x [y0, y1]
+/// of a set-up triangle, where weights are the
+/// barycentric coordinates and fixedValues are
+/// the integer edge functions of pixel (x0, y0).
+/// isCovered is true if the block is known to be
+/// entirely inside the triangle, in which case the
+/// coverage of its pixels isn't tested.
+///
+/// Returns the number of pixels that are covered
+/// and passed the depth test.
+///
+/// There's one such function for every
+/// combination of fragment shader and depth
+/// state (see blockRasterizers)
+////////////////////////////////////////
+typedef unsigned (*TXblockRasterizer) (struct TXrasterTriangle* rt,
+                                       int x0,
+                                       int y0,
+                                       int x1,
+                                       int y1,
+                                       TXvec3 weights,
+                                       const int32_t fixedValues[3],
+                                       bool isCovered);
+
+////////////////////////////////////////
+/// Shades the pixels [x0, x1] of row y of a
+/// set-up triangle, which are known to be
+/// covered by it and visible (see
+/// resolveVisibilityBuffer).
+///
+/// There's one such function for every
+/// fragment shader (see spanResolvers)
+////////////////////////////////////////
+typedef void (*TXspanResolver) (struct TXrasterTriangle* rt,
+                                int y,
+                                int x0,
+                                int x1);
+
+////////////////////////////////////////
+/// Vertex attributes that are interpolated
+/// with plane equations (see TXattributePlane)
+////////////////////////////////////////
+enum TXattributePlaneIndex { TX_COLOR_PLANE,
+                             TX_NORMAL_PLANE,
+                             TX_POSITION_PLANE,
+                             TX_NUM_ATTRIBUTE_PLANES };
+
+////////////////////////////////////////
+/// Screen-space plane equation of a vertex
+/// attribute multiplied by the inverted
+/// z-coordinate (-1/w) of the vertex: value
+/// is at pixel (minx, miny) of the triangle,
+/// dx and dy are how much it changes from
+/// one pixel to the next.
+///
+/// The interpolated depth is the plane of -1/w,
+/// so dividing a plane by it gives the
+/// perspective-correct attribute
+////////////////////////////////////////
+struct TXattributePlane {
+    TXvec4 value;
+    TXvec4 dx;
+    TXvec4 dy;
+};
+
+////////////////////////////////////////
+/// Everything the vertex shader and the
+/// rasterizer read, fetched once per draw call
+////////////////////////////////////////
+struct TXdrawState {
+    enum TXvertexInfo vertexInfo;
+    float* modelViewMatrix;
+    float* projectionMatrix;
+    float* normalMatrix;
+    float guardBand;
+
+    int shadeModel;
+    TXvec4 color;
+    bool depthTest;
+    bool depthMask;
+    enum TXdepthFunc depthFunc;
+    TXcontext_t* context;
+    int framebufferWidth;
+    int framebufferHeight;
+    TXframebufferInfo_t* framebufferInfo;
+    TXquery_t* query;
+    TXblockRasterizer rasterizeBlock;
+
+    // enum TXfragmentShader the triangles are
+    // shaded with, TX_FS_VISIBILITY aside
+    int shader;
+
+    // Bit (1 << TX_*_PLANE) is set for every
+    // attribute plane the fragment shader reads
+    unsigned attributePlanes;
+
+    // Face culling, see isFaceCulled
+    enum TXcullMode cullMode;
+    bool cullAll;
+    float cullSign;
+
+    TXspanResolver resolveSpan;
+};
+
+////////////////////////////////////////
+/// Everything the rasterizer needs to know
+/// about a clipped triangle once its vertices
+/// went through the vertex shader.
+///
+/// State that affects rasterization is captured
+/// here at submission time, so that in tiled mode
+/// (see txEnableTiledRendering) the triangle is
+/// rendered the same way no matter when the tiles
+/// are actually processed
+////////////////////////////////////////
+struct TXrasterTriangle {
+    enum TXvertexInfo vertexInfo;
+    int shadeModel;
+    TXvec4 color;
+
+    bool depthTest;
+    bool depthMask;
+    enum TXdepthFunc depthFunc;
+
+    // Context whose framebuffer and visibility
+    // buffer the triangle is rendered into
+    TXcontext_t* context;
+
+    // Owner of the hierarchical depth buffer,
+    // NULL for the default framebuffer
+    TXframebufferInfo_t* framebufferInfo;
+
+    // Occlusion query that counts the pixels
+    // passing the depth test, if any
+    TXquery_t* query;
+
+    TXvec3 zValues;
+    TXvec4 color0,  color1,  color2;
+    TXvec4 normal0, normal1, normal2;
+    TXvec4 mvPos0,  mvPos1,  mvPos2;
+
+    // Bounding box in window coordinates.
+    // Edge functions are set up at (minx, miny)
+    TXedgeFunctions_t edges;
+    TXfixedEdgeFunctions_t fixedEdges;
+    bool isFixedPoint;
+    int minx, miny;
+    int maxx, maxy;
+
+    // Only the planes given by
+    // TXdrawState::attributePlanes are set up
+    struct TXattributePlane planes[TX_NUM_ATTRIBUTE_PLANES];
+
+    TXblockRasterizer rasterizeBlock;
+
+    // See TXdrawState::shader. Lets command buffers
+    // pick rasterizeBlock again when submitted
+    int shader;
+
+    // Used by the visibility buffer, where
+    // id is 1 + the index of the triangle
+    TXspanResolver resolveSpan;
+    unsigned id;
+};
+
 ////////////////////////////////////////
-TX_FORCE_INLINE void runVertexShader(enum TXvertexInfo vertexInfo,
-                                     TXtriangle_t* tri,
-                                     TXvec4 ss_v0, TXvec4 ss_v1, TXvec4 ss_v2,
-                                     TXvec3 zValues,
-                                     TXvec4 normal0, TXvec4 normal1, TXvec4 normal2,
-                                     TXvec4 mvPos0,  TXvec4 mvPos1,  TXvec4 mvPos2)
+/// Computes the inverted z-coordinate and
+/// the window coordinates of a vertex
+/// that's inside the guard band
+////////////////////////////////////////
+TX_FORCE_INLINE void finishVertex(struct TXshadedVertex* sv, const struct TXdrawState* state)
 {
     ////////////////////////////////////////
     // Once upon a time, the following 3 divisions
@@ -388,43 +876,41 @@ TX_FORCE_INLINE void runVertexShader(enum TXvertexInfo vertexInfo,
     //
     // You may also wanna read this: https://citeseerx.ist.psu.edu/viewdoc/download?doi=10.1.1.72.6546&rep=rep1&type=pdf
     ////////////////////////////////////////
-    zValues[0] = -1.0f / tri->v0_pos[3];
-    zValues[1] = -1.0f / tri->v1_pos[3];
-    zValues[2] = -1.0f / tri->v2_pos[3];
+    sv->zValue = -1.0f / sv->clipPos[3];
     ////////////////////////////////////////
 
-    txConvertToWindowSpace(ss_v0, tri->v0_pos);
-    txConvertToWindowSpace(ss_v1, tri->v1_pos);
-    txConvertToWindowSpace(ss_v2, tri->v2_pos);
+    convertToWindowSpace(sv->windowPos, sv->clipPos, (float)state->framebufferWidth, (float)state->framebufferHeight);
+}
 
-    switch (vertexInfo) {
+////////////////////////////////////////
+/// A single invocation of this function
+/// corresponds to a single invocation of
+/// a vertex shader in a typical
+/// hardware-accelerated graphics pipeline.
+////////////////////////////////////////
+TX_FORCE_INLINE void runVertexShader(struct TXshadedVertex* sv,
+                                     TXvec4 vertex[],
+                                     const struct TXdrawState* state)
+{
+    // Face-culling and lighting occur in view-space
+    txMulMat4Vec4(sv->viewPos, state->modelViewMatrix, vertex[0]);
+    txMulMat4Vec4(sv->clipPos, state->projectionMatrix, sv->viewPos);
+
+    txVec4Zero(sv->color);
+    txVec4Zero(sv->normal);
+
+    switch (state->vertexInfo) {
         case TX_POSITION_NORMAL:
-            txConvertToCustomSpace(mvPos0, mvPos1, mvPos2,
-                                   txGetModelViewMatrix(),
-                                   tri->v0_obj_pos,
-                                   tri->v1_obj_pos,
-                                   tri->v2_obj_pos);
-            txConvertToCustomSpace(normal0, normal1, normal2,
-                                   txGetNormalMatrix(),
-                                   tri->v0_attr0,
-                                   tri->v1_attr0,
-                                   tri->v2_attr0);
+            txMulMat4Vec4(sv->normal, state->normalMatrix, vertex[1]);
             break;
         case TX_POSITION_COLOR_NORMAL:
-            txConvertToCustomSpace(mvPos0, mvPos1, mvPos2,
-                                   txGetModelViewMatrix(),
-                                   tri->v0_obj_pos,
-                                   tri->v1_obj_pos,
-                                   tri->v2_obj_pos);
-            txConvertToCustomSpace(normal0, normal1, normal2,
-                                   txGetNormalMatrix(),
-                                   tri->v0_attr1,
-                                   tri->v1_attr1,
-                                   tri->v2_attr1);
+            txVec4Copy(sv->color, vertex[1]);
+            txMulMat4Vec4(sv->normal, state->normalMatrix, vertex[2]);
             break;
         case TX_POSITION:
             break;
         case TX_POSITION_COLOR:
+            txVec4Copy(sv->color, vertex[1]);
             break;
         case TX_POSITION_TEXCOORD:
         case TX_POSITION_COLOR_TEXCOORD:
@@ -433,18 +919,21 @@ TX_FORCE_INLINE void runVertexShader(enum TXvertexInfo vertexInfo,
             txOutputMessage(TX_INFO, "[CursedGL] runVertexShader: given VAO configuration is currently not implemented");
             break;
         default:
-            txOutputMessage(TX_WARNING, "[CursedGL] runVertexShader: given VOA configuration (%d) is invalid", vertexInfo);
+            txOutputMessage(TX_WARNING, "[CursedGL] runVertexShader: given VOA configuration (%d) is invalid", state->vertexInfo);
             break;
     }
+
+    sv->outcode = txComputeOutcode(sv->clipPos, state->guardBand);
+    if (!sv->outcode)
+        finishVertex(sv, state);
 }
 
 ////////////////////////////////////////
-/// Given vertexInfo (i.e. VAO configuration),
-/// triangle tri, weights, zValues, and interpolatedZ,
+/// Given a set-up triangle rt, weights, and interpolatedZ,
 /// run the fragment shader and the store result
 /// in outputColor.
 ///
-/// zValues is an array containing the inverted z-coordinates
+/// rt->zValues is an array containing the inverted z-coordinates
 /// of each vertex of the given triangle
 ///
 /// interpolatedZ is the interpolated z-coordinate
@@ -454,22 +943,23 @@ TX_FORCE_INLINE void runVertexShader(enum TXvertexInfo vertexInfo,
 /// coordinates of the current pixel in screen-space
 ///
 /// To see how the above 3 values are computed see
-/// renderTriangles in rasterizer.c
+/// setupTriangle and rasterizeTriangle in rasterizer.c
 ///
-/// normal{0,1,2} are normals processed by the vertex
+/// rt->normal{0,1,2} are normals processed by the vertex
 /// shader
 ///
-/// mvPos{0,1,2} are positions of each vertex of a
+/// rt->mvPos{0,1,2} are positions of each vertex of a
 /// triangle in model-view space (also processed
 /// by the vertex shader)
+///
+/// The rasterizer only falls back to this
+/// function for configurations that don't
+/// have a specialized fragment shader
+/// (see TXfragmentShader)
 ////////////////////////////////////////
-TX_FORCE_INLINE void runFragmentShader(enum TXvertexInfo vertexInfo,
-                                       TXtriangle_t* tri,
+TX_FORCE_INLINE void runFragmentShader(struct TXrasterTriangle* rt,
                                        TXvec4 outputColor,
                                        TXvec3 weights,
-                                       TXvec3 zValues,
-                                       TXvec4 normal0, TXvec4 normal1, TXvec4 normal2,
-                                       TXvec4 mvPos0,  TXvec4 mvPos1,  TXvec4 mvPos2,
                                        float interpolatedZ)
 {
     TXvec4 interpolatedNormals   = TX_VEC4_ZERO;
@@ -480,42 +970,42 @@ TX_FORCE_INLINE void runFragmentShader(enum TXvertexInfo vertexInfo,
     // is not implemented yet
 
     TXvec3 viewDir;
-    switch (vertexInfo) {
+    switch (rt->vertexInfo) {
         case TX_POSITION:
-            txVec4Copy(outputColor, txGetColorPtr());
+            txVec4Copy(outputColor, rt->color);
             break;
         case TX_POSITION_COLOR:
             txInterpolateVertexElement(outputColor,
-                                       tri->v0_attr0, tri->v1_attr0, tri->v2_attr0,
+                                       rt->color0, rt->color1, rt->color2,
                                        weights,
-                                       zValues,
+                                       rt->zValues,
                                        interpolatedZ);
             break;
         case TX_POSITION_NORMAL:
-            switch (shadeModel) {
+            switch (rt->shadeModel) {
                 case TX_UNLIT:
-                    txVec4Copy(outputColor, txGetColorPtr());
+                    txVec4Copy(outputColor, rt->color);
                     return;
                 case TX_FLAT:
                     txVec3Zero(outputColor);
                     txAverageVertexElement(interpolatedNormals,
-                                           normal0, normal1, normal2);
+                                           rt->normal0, rt->normal1, rt->normal2);
 
                     txAverageVertexElement(interpolatedPositions,
-                                           mvPos0, mvPos1, mvPos2);
+                                           rt->mvPos0, rt->mvPos1, rt->mvPos2);
                     break;
                 case TX_SMOOTH:
                     txVec3Zero(outputColor);
                     txInterpolateVertexElement(interpolatedNormals,
-                                               normal0, normal1, normal2,
+                                               rt->normal0, rt->normal1, rt->normal2,
                                                weights,
-                                               zValues,
+                                               rt->zValues,
                                                interpolatedZ);
 
                     txInterpolateVertexElement(interpolatedPositions,
-                                               mvPos0, mvPos1, mvPos2,
+                                               rt->mvPos0, rt->mvPos1, rt->mvPos2,
                                                weights,
-                                               zValues,
+                                               rt->zValues,
                                                interpolatedZ);
                     break;
             }
@@ -541,32 +1031,32 @@ TX_FORCE_INLINE void runFragmentShader(enum TXvertexInfo vertexInfo,
             break;
         case TX_POSITION_COLOR_NORMAL:
             txInterpolateVertexElement(outputColor,
-                                       tri->v0_attr0, tri->v1_attr0, tri->v2_attr0,
+                                       rt->color0, rt->color1, rt->color2,
                                        weights,
-                                       zValues,
+                                       rt->zValues,
                                        interpolatedZ);
 
-            switch (shadeModel) {
+            switch (rt->shadeModel) {
                 case TX_UNLIT:
                     return;
                 case TX_FLAT:
                     txAverageVertexElement(interpolatedNormals,
-                                           normal0, normal1, normal2);
+                                           rt->normal0, rt->normal1, rt->normal2);
 
                     txAverageVertexElement(interpolatedPositions,
-                                           mvPos0, mvPos1, mvPos2);
+                                           rt->mvPos0, rt->mvPos1, rt->mvPos2);
                     break;
                 case TX_SMOOTH:
                     txInterpolateVertexElement(interpolatedNormals,
-                                               normal0, normal1, normal2,
+                                               rt->normal0, rt->normal1, rt->normal2,
                                                weights,
-                                               zValues,
+                                               rt->zValues,
                                                interpolatedZ);
 
                     txInterpolateVertexElement(interpolatedPositions,
-                                               mvPos0, mvPos1, mvPos2,
+                                               rt->mvPos0, rt->mvPos1, rt->mvPos2,
                                                weights,
-                                               zValues,
+                                               rt->zValues,
                                                interpolatedZ);
                     break;
             }
@@ -604,10 +1094,10 @@ bool txShouldCullFace(TXvec3 view_v0,
                       TXvec3 view_v1,
                       TXvec3 view_v2)
 {
-    if (txIsCullingEnabled()) {
-        if (cullFace == TX_FRONT_AND_BACK)
+    if (isCullingEnabled(currentState->context)) {
+        if (currentState->cullFace == TX_FRONT_AND_BACK)
             return true;
-        else if (cullFace == TX_NONE)
+        else if (currentState->cullFace == TX_NONE)
             return false;
 
         TXvec3 vec0, vec1;
@@ -632,8 +1122,8 @@ bool txShouldCullFace(TXvec3 view_v0,
 
         float d = txVec3Dot(normal, normalToEye);
 
-        if ((windOrder == TX_CCW && cullFace == TX_BACK) ||
-            (windOrder == TX_CW  && cullFace == TX_FRONT))
+        if ((currentState->windOrder == TX_CCW && currentState->cullFace == TX_BACK) ||
+            (currentState->windOrder == TX_CW  && currentState->cullFace == TX_FRONT))
             return d < 0.0f;
         else
             return d > 0.0f;
@@ -699,352 +1189,2920 @@ bool txIsPointInTriangle(int i,
 }
 
 ////////////////////////////////////////
-void txDrawPoint(TXvec4 v0)
+/// Keeps the hierarchical depth buffer
+/// conservative after writing a single depth
+////////////////////////////////////////
+static void expandHiZ(const TXcontext_t* context, int row, int col, float depth)
+{
+    TXframebufferInfo_t* framebufferInfo = context->framebufferInfo;
+    TXhiZTile_t* tile = framebufferInfo ? txGetHiZTileFromCurrentFramebuffer(framebufferInfo, row, col) : NULL;
+    if (tile)
+        txExpandHiZTile(tile, depth);
+}
+
+////////////////////////////////////////
+/// Writes color to the pixel at (x, y)
+/// if depth passes the depth test
+////////////////////////////////////////
+static void plotPixel(int x, int y, float depth, TXvec4 color)
+{
+    const TXcontext_t* context = currentState->context;
+    TXpixel_t* p = getPixel(context, y, x);
+    bool writesPixel = !currentState->activeQuery.query || currentState->activeQuery.mode != TX_SAMPLES_PASSED_NO_WRITE;
+    if (isDepthTestEnabled(context)) {
+        if (!passesDepthTest(context, depth, p->depth))
+            return;
+        if (getDepthMask(context) && writesPixel) {
+            p->depth = depth;
+            expandHiZ(context, y, x, depth);
+        }
+    }
+
+    // Points and lines are drawn right after
+    // a flush, so no tile can be counting too
+    if (currentState->activeQuery.query)
+        ++currentState->activeQuery.query->samplesPassed;
+
+    if (currentState->colorMask && writesPixel)
+        txVec4Copy(p->color, color);
+}
+
+////////////////////////////////////////
+/// Returns the color of vertex i, where colors
+/// are colorStride bytes apart (0 meaning tightly
+/// packed), or the current color if there are none
+////////////////////////////////////////
+static float* getVertexColor(float* colors, size_t colorStride, int i)
+{
+    if (!colors)
+        return currentState->rasterColor;
+    if (!colorStride)
+        colorStride = sizeof(TXvec4);
+    return (float*)((unsigned char*)colors + (size_t)i * colorStride);
+}
+
+////////////////////////////////////////
+/// Rasterizes a point whose position
+/// is in clip-space
+////////////////////////////////////////
+static void drawPoint(TXvec4 clip_v0, TXvec4 color)
 {
-    TXvec4 viewport_v0;
-    txConvertToViewSpace(viewport_v0, v0);
-    txConvertToClipSpace(viewport_v0, viewport_v0);
-    txConvertToWindowSpace(viewport_v0, viewport_v0);
+    if (txComputeOutcode(clip_v0, 1.0f))
+        return;
+
+    const TXcontext_t* context = currentState->context;
+    int fbWidth  = getFramebufferWidth(context);
+    int fbHeight = getFramebufferHeight(context);
+
+    TXvec3 viewport_v0;
+    convertToWindowSpace(viewport_v0, clip_v0, (float)fbWidth, (float)fbHeight);
 
     int x = (int)viewport_v0[0];
     int y = (int)viewport_v0[1];
 
-    int fbWidth  = txGetFramebufferWidth();
-    int fbHeight = txGetFramebufferHeight();
-
-    float depth = viewport_v0[2];
-    if ((x < 0 || x >= fbWidth) ||
-        (y < 0 || y >= fbHeight) ||
-        (depth < 0.0f || depth > 1.0f))
-    {
+    // Points on the right or bottom edge
+    // of the viewport are outside of it
+    if (x >= fbWidth || y >= fbHeight)
         return;
-    }
 
     // Points currently do not react to lighting.
     // Not sure if they should
 
-    TXpixel_t* p = txGetPixelFromBackFramebuffer(y, x);
-    if (txIsDepthTestEnabled() && txCompareDepth(depth, p->depth)) {
-        txVec4Copy(p->color, rasterColor);
-        if (txGetDepthMask())
-            p->depth = depth;
-    }
-    else
-        txVec4Copy(p->color, rasterColor);
+    plotPixel(x, y, viewport_v0[2], color);
 }
 
 ////////////////////////////////////////
-void txDrawLine(TXvec4 v0, TXvec4 v1)
+/// Rasterizes a line whose endpoints are
+/// in window coordinates with a DDA: the
+/// line is walked one pixel at a time along
+/// its major axis, stepping the minor axis,
+/// depth and color incrementally
+////////////////////////////////////////
+static void rasterizeLine(TXvec3 viewport_v0,
+                          TXvec3 viewport_v1,
+                          TXvec4 color0,
+                          TXvec4 color1)
 {
-    TXvec4 viewport_v0, viewport_v1;
-    txConvertToViewSpace(viewport_v0, v0);
-    txConvertToViewSpace(viewport_v1, v1);
-
-    txConvertToClipSpace(viewport_v0, viewport_v0);
-    txConvertToClipSpace(viewport_v1, viewport_v1);
-
-    txConvertToWindowSpace(viewport_v0, viewport_v0);
-    txConvertToWindowSpace(viewport_v1, viewport_v1);
+    int fbWidth  = getFramebufferWidth(currentState->context);
+    int fbHeight = getFramebufferHeight(currentState->context);
 
-    int fbWidth  = txGetFramebufferWidth();
-    int fbHeight = txGetFramebufferHeight();
+    float dx = viewport_v1[0] - viewport_v0[0];
+    float dy = viewport_v1[1] - viewport_v0[1];
+    float dz = viewport_v1[2] - viewport_v0[2];
 
-    int minx = (int)fmaxf(0.0f, fminf(viewport_v0[0], viewport_v1[0]));
-    int miny = (int)fmaxf(0.0f, fminf(viewport_v0[1], viewport_v1[1]));
+    TXvec4 color, dcolor;
+    txVec4Copy(color, color0);
+    txVec4Sub(dcolor, color1, color0);
 
-    int maxx = (int)fminf((float)fbWidth  - TX_FB_BIAS, fmaxf(viewport_v0[0],
-                                                              viewport_v1[0]));
-    int maxy = (int)fminf((float)fbHeight - TX_FB_BIAS, fmaxf(viewport_v0[1],
-                                                              viewport_v1[1]));
+    int numSteps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy)));
+    if (numSteps > 0) {
+        float invNumSteps = 1.0f / (float)numSteps;
+        dx *= invNumSteps;
+        dy *= invNumSteps;
+        dz *= invNumSteps;
+        txVec4ScalarMul(dcolor, dcolor, invNumSteps);
+    }
 
-    if (minx < 0 || miny < 0 || maxx >= fbWidth || maxy >= fbHeight)
-        return;
+    float x = viewport_v0[0];
+    float y = viewport_v0[1];
+    float z = viewport_v0[2];
 
     // Lines also do not react to light sources. Not sure if they should.
 
-    for (int i = miny; i <= maxy; ++i) {
-        for (int j = minx; j <= maxx; ++j) {
-            if (txIsPointInLine(j, i, viewport_v0, viewport_v1)) {
-                float interpolatedDepth = txInterpolateLineDepth(j,
-                                                                 i,
-                                                                 viewport_v0,
-                                                                 viewport_v1);
-
-                // Perhaps instead of clipping the line,
-                // we could simply reject those pixels on
-                // the line that fall outside of near and far
-                // planes?
-                if (interpolatedDepth < 0.0f || interpolatedDepth > 1.0f)
-                    continue;
+    for (int k = 0; k <= numSteps; ++k, x += dx, y += dy, z += dz, txVec4Add(color, color, dcolor)) {
+        int j = (int)x;
+        int i = (int)y;
 
-                TXpixel_t* p = txGetPixelFromBackFramebuffer(i, j);
-                if (txIsDepthTestEnabled()) {
-                    if (txCompareDepth(interpolatedDepth, p->depth)) {
-                        txVec4Copy(p->color, rasterColor);
-                        if (txGetDepthMask())
-                            p->depth = interpolatedDepth;
-                    }
-                }
-                else
-                    txVec4Copy(p->color, rasterColor);
-            }
-        }
+        // Clipped endpoints may lie exactly on
+        // the right or bottom edge of the viewport
+        if (j >= 0 && j < fbWidth && i >= 0 && i < fbHeight)
+            plotPixel(j, i, z, color);
     }
 }
 
 ////////////////////////////////////////
-static int clipVertices(TXtriangle_t triangles[])
+/// Clips and rasterizes a line whose
+/// endpoints are in clip-space
+////////////////////////////////////////
+static void drawLine(TXvec4 clip_v0, TXvec4 clip_v1, TXvec4 color0, TXvec4 color1)
 {
-    static TXvec3 nearPlaneNormal = { 0.0f, 0.0f,  1.0f };
-    static TXvec3 farPlaneNormal  = { 0.0f, 0.0f, -1.0f };
+    // Lines are clipped against the viewport itself,
+    // so that the rasterizer only walks visible pixels
+    unsigned outcode0 = txComputeOutcode(clip_v0, 1.0f);
+    unsigned outcode1 = txComputeOutcode(clip_v1, 1.0f);
+    if (outcode0 & outcode1)
+        return;
 
-    float* projectionMatrix = txGetProjectionMatrix();
+    float fbWidth  = (float)getFramebufferWidth(currentState->context);
+    float fbHeight = (float)getFramebufferHeight(currentState->context);
 
-    float near = projectionMatrix[14] / (projectionMatrix[10] - 1.0f);
-    float far = projectionMatrix[14] / (projectionMatrix[10] + 1.0f);
+    TXvec3 viewport_v0, viewport_v1;
+    if (outcode0 | outcode1) {
+        TXvec4 clipped_v0, clipped_v1;
+        txVec4Copy(clipped_v0, clip_v0);
+        txVec4Copy(clipped_v1, clip_v1);
 
-    TXvec3 nearPlanePosition = { 0.0f, 0.0f, near };
-    TXvec3 farPlanePosition  = { 0.0f, 0.0f, far  };
+        float t0, t1;
+        if (!txClipLine(clipped_v0, clipped_v1, outcode0 | outcode1, 1.0f, &t0, &t1))
+            return;
 
-    // first check against the near plane
-    int numTriangles = txClipTriangleAgainstPlane(&triangles[0],
-                                                  &triangles[1],
-                                                  nearPlanePosition,
-                                                  nearPlaneNormal,
-                                                  &triangles[0]);
+        TXvec4 clippedColor0, clippedColor1;
+        txVec4Lerp(clippedColor0, color0, color1, t0);
+        txVec4Lerp(clippedColor1, color0, color1, t1);
 
-    // then check against the far plane
-    int totalNumTriangles;
-    switch (numTriangles) {
-        case 0:
-            return 0;
-        case 1:
-            return txClipTriangleAgainstPlane(&triangles[0],
-                                              &triangles[1],
-                                              farPlanePosition,
-                                              farPlaneNormal,
-                                              &triangles[0]);
-        case 2:
-            totalNumTriangles = numTriangles;
-            numTriangles = txClipTriangleAgainstPlane(&triangles[0],
-                                                      &triangles[totalNumTriangles],
-                                                      farPlanePosition,
-                                                      farPlaneNormal,
-                                                      &triangles[0]);
-            if (numTriangles == 0)
-                return 0;
-            else if (numTriangles > 1)
-                ++totalNumTriangles;
-
-            numTriangles = txClipTriangleAgainstPlane(&triangles[1],
-                                                      &triangles[totalNumTriangles],
-                                                      farPlanePosition,
-                                                      farPlaneNormal,
-                                                      &triangles[1]);
-            if (numTriangles == 0)
-                return 0;
-            else if (numTriangles > 1)
-                ++totalNumTriangles;
-            return totalNumTriangles;
+        convertToWindowSpace(viewport_v0, clipped_v0, fbWidth, fbHeight);
+        convertToWindowSpace(viewport_v1, clipped_v1, fbWidth, fbHeight);
+        rasterizeLine(viewport_v0, viewport_v1, clippedColor0, clippedColor1);
+    }
+    else {
+        convertToWindowSpace(viewport_v0, clip_v0, fbWidth, fbHeight);
+        convertToWindowSpace(viewport_v1, clip_v1, fbWidth, fbHeight);
+        rasterizeLine(viewport_v0, viewport_v1, color0, color1);
     }
-    return 0;
 }
 
 ////////////////////////////////////////
-static void renderTriangles(enum TXvertexInfo vertexInfo,
-                            TXtriangle_t triangles[],
-                            int numTriangles)
-{
-    for (int tri = 0; tri < numTriangles; ++tri) {
-        TXvec4 viewport_v0, viewport_v1, viewport_v2;
-
-        TXvec4 normal0, normal1, normal2;
-        txVec4Zero(normal0);
-        txVec4Zero(normal1);
-        txVec4Zero(normal2);
-
-        TXvec4 mvPos0, mvPos1, mvPos2;
-        txVec4Zero(mvPos0);
-        txVec4Zero(mvPos1);
-        txVec4Zero(mvPos2);
-
-        TXvec3 zValues;
-
-        ////////////////////////////////////////
-        /////// VERTEX SHADER EMULATION ////////
-        ////////////////////////////////////////
-
-        runVertexShader(vertexInfo,
-                        &triangles[tri],
-                        viewport_v0, viewport_v1, viewport_v2,
-                        zValues,
-                        normal0, normal1, normal2,
-                        mvPos0, mvPos1, mvPos2);
-
-        ////////////////////////////////////////
-        //////// VERTEX SHADER COMPLETE ////////
-        ////////////////////////////////////////
-
-        int fbWidth  = txGetFramebufferWidth();
-        int fbHeight = txGetFramebufferHeight();
-
-        int minx = (int)fmaxf(0.0f, txMin3(viewport_v0[0],
-                                           viewport_v1[0],
-                                           viewport_v2[0]));
-        int miny = (int)fmaxf(0.0f, txMin3(viewport_v0[1],
-                                           viewport_v1[1],
-                                           viewport_v2[1]));
-        int maxx = (int)fminf((float)fbWidth  - TX_FB_BIAS, txMax3(viewport_v0[0],
-                                                                   viewport_v1[0],
-                                                                   viewport_v2[0]));
-        int maxy = (int)fminf((float)fbHeight - TX_FB_BIAS, txMax3(viewport_v0[1],
-                                                                   viewport_v1[1],
-                                                                   viewport_v2[1]));
-
-        ////////////////////////////////////////
-        /////// BARYCENTRIC COORDINATES ////////
-        ////////////////////////////////////////
-        TXvec3 weights;
-
-        ////////////////////////////////////////
-        /////// OUTPUT COLOR OF THE PIXEL //////
-        ////////////////////////////////////////
-        TXvec4 outputColor = TX_VEC4_W1;
-
-        for (int i = miny; i <= maxy; ++i) {
-            for (int j = minx; j <= maxx; ++j) {
-                if (txIsPointInTriangle(j,
-                                        i,
-                                        viewport_v0,
-                                        viewport_v1,
-                                        viewport_v2,
-                                        weights)) {
-                    float interpolatedDepth = txVec3Dot(zValues, weights);
-
-                    TXpixel_t* p = txGetPixelFromBackFramebuffer(i, j);
-                    if (txIsDepthTestEnabled()) {
-                        if (txCompareDepth(interpolatedDepth, p->depth)) {
-
-                            ////////////////////////////////////////
-                            /////// FRAGMENT SHADER EMULATION //////
-                            ////////////////////////////////////////
-                            runFragmentShader(vertexInfo,
-                                              &triangles[tri],
-                                              outputColor,
-                                              weights,
-                                              zValues,
-                                              normal0, normal1, normal2,
-                                              mvPos0, mvPos1, mvPos2,
-                                              interpolatedDepth);
-                            ////////////////////////////////////////
-                            /////// FRAGMENT SHADER COMPLETE ///////
-                            ////////////////////////////////////////
-
-                            txVec4Clamp(outputColor, outputColor, 0.0f, 1.0f);
-                            txVec4Copy(p->color, outputColor);
-                            if (txGetDepthMask())
-                                p->depth = interpolatedDepth;
-                        }
-                    }
-                    else {
-                        ////////////////////////////////////////
-                        /////// FRAGMENT SHADER EMULATION //////
-                        ////////////////////////////////////////
-                        runFragmentShader(vertexInfo,
-                                          &triangles[tri],
-                                          outputColor,
-                                          weights,
-                                          zValues,
-                                          normal0, normal1, normal2,
-                                          mvPos0, mvPos1, mvPos2,
-                                          interpolatedDepth);
-                        ////////////////////////////////////////
-                        /////// FRAGMENT SHADER COMPLETE ///////
-                        ////////////////////////////////////////
-
-                        txVec4Clamp(outputColor, outputColor, 0.0f, 1.0f);
-                        txVec4Copy(p->color, outputColor);
-                    }
-                }
-            }
-        }
-    }
+/// Returns true if the calling thread is
+/// recording a command buffer, which caller
+/// can't be recorded into
+////////////////////////////////////////
+static bool isRecording(const char* caller)
+{
+    if (!currentState->recordedBatch)
+        return false;
+    txOutputMessage(TX_WARNING, "[CursedGL] %s: not allowed while recording a command buffer", caller);
+    return true;
 }
 
 ////////////////////////////////////////
-void txDrawTriangle(TXvec4 v0[],
-                    TXvec4 v1[],
-                    TXvec4 v2[],
-                    enum TXvertexInfo vertexInfo)
+void txDrawPoint(TXvec4 v0)
 {
-    TXvec4 pos_v0, pos_v1, pos_v2;
+    if (isRecording("txDrawPoint"))
+        return;
+
+    // Binned triangles were submitted before
+    // this primitive, so they must land first
+    txFinish();
 
-    // Face-culling occurs in view-space
-    txConvertToViewSpace(pos_v0, v0[0]);
-    txConvertToViewSpace(pos_v1, v1[0]);
-    txConvertToViewSpace(pos_v2, v2[0]);
+    TXvec4 clip_v0;
+    txConvertToViewSpace(clip_v0, v0);
+    txConvertToClipSpace(clip_v0, clip_v0);
 
-    if (txShouldCullFace(pos_v0, pos_v1, pos_v2))
+    drawPoint(clip_v0, currentState->rasterColor);
+}
+
+////////////////////////////////////////
+void txDrawLine(TXvec4 v0, TXvec4 v1)
+{
+    if (isRecording("txDrawLine"))
         return;
 
-    // We may have to clip our triangle
-    txConvertToClipSpace(pos_v0, pos_v0);
-    txConvertToClipSpace(pos_v1, pos_v1);
-    txConvertToClipSpace(pos_v2, pos_v2);
+    // Binned triangles were submitted before
+    // this primitive, so they must land first
+    txFinish();
 
-    // Allocate enough memory for max
-    // possible number of triangles
-    TXtriangle_t triangles[4];
+    TXvec4 clip_v0, clip_v1;
+    txConvertToViewSpace(clip_v0, v0);
+    txConvertToViewSpace(clip_v1, v1);
 
-    // Clip coordinates for clipping
-    txVec4Copy(triangles[0].v0_pos, pos_v0);
-    txVec4Copy(triangles[0].v1_pos, pos_v1);
-    txVec4Copy(triangles[0].v2_pos, pos_v2);
+    txConvertToClipSpace(clip_v0, clip_v0);
+    txConvertToClipSpace(clip_v1, clip_v1);
 
-    // World coordinates for lighting
-    txVec4Copy(triangles[0].v0_obj_pos, v0[0]);
-    txVec4Copy(triangles[0].v1_obj_pos, v1[0]);
-    txVec4Copy(triangles[0].v2_obj_pos, v2[0]);
+    drawLine(clip_v0, clip_v1, currentState->rasterColor, currentState->rasterColor);
+}
 
-    // Populate the triangles[0] by copying the
-    // appropriate attributes based on a given
-    // VAO configuration
-    switch (vertexInfo) {
-        case TX_POSITION_COLOR_NORMAL_TEXCOORD:
-            txVec4Copy(triangles[0].v0_attr0, v0[1]);
-            txVec4Copy(triangles[0].v1_attr0, v1[1]);
-            txVec4Copy(triangles[0].v2_attr0, v2[1]);
+////////////////////////////////////////
+void txDrawPoints(TXvec4* vertices,
+                  int numVertices,
+                  float* colors,
+                  size_t colorStride)
+{
+    if (isRecording("txDrawPoints"))
+        return;
 
-            txVec4Copy(triangles[0].v0_attr1, v0[2]);
-            txVec4Copy(triangles[0].v1_attr1, v1[2]);
-            txVec4Copy(triangles[0].v2_attr1, v2[2]);
+    txFinish();
 
-            txVec4Copy(triangles[0].v0_attr2, v0[3]);
-            txVec4Copy(triangles[0].v1_attr2, v1[3]);
-            txVec4Copy(triangles[0].v2_attr2, v2[3]);
-            break;
-        case TX_POSITION_COLOR_NORMAL:
-        case TX_POSITION_COLOR_TEXCOORD:
-        case TX_POSITION_NORMAL_TEXCOORD:
-            txVec4Copy(triangles[0].v0_attr0, v0[1]);
-            txVec4Copy(triangles[0].v1_attr0, v1[1]);
-            txVec4Copy(triangles[0].v2_attr0, v2[1]);
+    TXmat4 modelViewProjectionMatrix;
+    txMat4Mul(modelViewProjectionMatrix, txGetProjectionMatrix(), txGetModelViewMatrix());
 
-            txVec4Copy(triangles[0].v0_attr1, v0[2]);
-            txVec4Copy(triangles[0].v1_attr1, v1[2]);
-            txVec4Copy(triangles[0].v2_attr1, v2[2]);
-            break;
-        case TX_POSITION_COLOR:
-        case TX_POSITION_NORMAL:
-        case TX_POSITION_TEXCOORD:
-            txVec4Copy(triangles[0].v0_attr0, v0[1]);
-            txVec4Copy(triangles[0].v1_attr0, v1[1]);
-            txVec4Copy(triangles[0].v2_attr0, v2[1]);
-            break;
-        case TX_POSITION:
-            break;
+    TXvec4 clipVertices[TX_VERTEX_BATCH_SIZE];
+    for (int base = 0; base < numVertices; base += TX_VERTEX_BATCH_SIZE) {
+        int numBatchVertices = numVertices - base < TX_VERTEX_BATCH_SIZE ? numVertices - base : TX_VERTEX_BATCH_SIZE;
+        txTransformVertices(clipVertices, modelViewProjectionMatrix, &vertices[base], numBatchVertices);
+
+        for (int i = 0; i < numBatchVertices; ++i)
+            drawPoint(clipVertices[i], getVertexColor(colors, colorStride, base + i));
+    }
+}
+
+////////////////////////////////////////
+/// Draws lines between vertices i and i + 1,
+/// for i = 0, vertexStep, 2 * vertexStep, ...
+/// Transforms vertices TX_VERTEX_BATCH_SIZE
+/// at a time
+////////////////////////////////////////
+static void drawLines(TXvec4* vertices,
+                      int numVertices,
+                      float* colors,
+                      size_t colorStride,
+                      int vertexStep)
+{
+    txFinish();
+
+    TXmat4 modelViewProjectionMatrix;
+    txMat4Mul(modelViewProjectionMatrix, txGetProjectionMatrix(), txGetModelViewMatrix());
+
+    TXvec4 clipVertices[TX_VERTEX_BATCH_SIZE];
+    for (int base = 0; base + 1 < numVertices;) {
+        int numBatchVertices = numVertices - base < TX_VERTEX_BATCH_SIZE ? numVertices - base : TX_VERTEX_BATCH_SIZE;
+        txTransformVertices(clipVertices, modelViewProjectionMatrix, &vertices[base], numBatchVertices);
+
+        int i = 0;
+        for (; i + 1 < numBatchVertices; i += vertexStep) {
+            drawLine(clipVertices[i],
+                     clipVertices[i + 1],
+                     getVertexColor(colors, colorStride, base + i),
+                     getVertexColor(colors, colorStride, base + i + 1));
+        }
+
+        // A line strip's next batch starts
+        // with the last vertex of this one
+        base += i;
     }
+}
+
+////////////////////////////////////////
+void txDrawLines(TXvec4* vertices,
+                 int numVertices,
+                 float* colors,
+                 size_t colorStride)
+{
+    if (isRecording("txDrawLines"))
+        return;
+
+    drawLines(vertices, numVertices, colors, colorStride, 2);
+}
 
-    int numTriangles = clipVertices(triangles);
-    renderTriangles(vertexInfo, triangles, numTriangles);
+////////////////////////////////////////
+void txDrawLineStrip(TXvec4* vertices,
+                     int numVertices,
+                     float* colors,
+                     size_t colorStride)
+{
+    if (isRecording("txDrawLineStrip"))
+        return;
+
+    drawLines(vertices, numVertices, colors, colorStride, 1);
+}
+
+////////////////////////////////////////
+void txDrawLineLoop(TXvec4* vertices,
+                    int numVertices,
+                    float* colors,
+                    size_t colorStride)
+{
+    if (isRecording("txDrawLineLoop"))
+        return;
+
+    drawLines(vertices, numVertices, colors, colorStride, 1);
+    if (numVertices > 2) {
+        TXvec4 clip_v0, clip_v1;
+        txConvertToViewSpace(clip_v0, vertices[numVertices - 1]);
+        txConvertToViewSpace(clip_v1, vertices[0]);
+
+        txConvertToClipSpace(clip_v0, clip_v0);
+        txConvertToClipSpace(clip_v1, clip_v1);
+
+        drawLine(clip_v0,
+                 clip_v1,
+                 getVertexColor(colors, colorStride, numVertices - 1),
+                 getVertexColor(colors, colorStride, 0));
+    }
+}
+
+////////////////////////////////////////
+/// Returns the guard band actually used for
+/// clipping. It's the one set by txSetGuardBand,
+/// shrunk so that the window coordinates of
+/// unclipped vertices still fit in the fixed-point
+/// range of the rasterizer
+////////////////////////////////////////
+static float getEffectiveGuardBand(int fbWidth, int fbHeight)
+{
+    float fbMaxDim = fmaxf((float)fbWidth, (float)fbHeight);
+    float fixedPointGuardBand = 2.0f * TX_SUBPIXEL_RANGE / fbMaxDim - 1.0f;
+    return fmaxf(1.0f, fminf(currentState->guardBand, fixedPointGuardBand));
+}
+
+////////////////////////////////////////
+/// Sets up the plane equation of the attribute
+/// whose values at the vertices are a0, a1
+/// and a2 (see TXattributePlane)
+////////////////////////////////////////
+TX_FORCE_INLINE void setupAttributePlane(struct TXattributePlane* plane,
+                                         const TXedgeFunctions_t* edges,
+                                         const TXvec3 zValues,
+                                         const TXvec4 a0,
+                                         const TXvec4 a1,
+                                         const TXvec4 a2)
+{
+    for (int k = 0; k < 4; ++k) {
+        float p0 = a0[k] * zValues[0];
+        float p1 = a1[k] * zValues[1];
+        float p2 = a2[k] * zValues[2];
+
+        plane->value[k] = p0 * edges->weights[0] + p1 * edges->weights[1] + p2 * edges->weights[2];
+        plane->dx[k]    = p0 * edges->dx[0]      + p1 * edges->dx[1]      + p2 * edges->dx[2];
+        plane->dy[k]    = p0 * edges->dy[0]      + p1 * edges->dy[1]      + p2 * edges->dy[2];
+    }
+}
+
+////////////////////////////////////////
+/// Tests the integer edge functions of a
+/// triangle at every pixel of its bounding box,
+/// returns true if any pixel is covered
+////////////////////////////////////////
+TX_FORCE_INLINE bool coversAnyPixel(const struct TXrasterTriangle* rt)
+{
+    const TXfixedEdgeFunctions_t* fixedEdges = &rt->fixedEdges;
+    for (int i = 0; i <= rt->maxy - rt->miny; ++i) {
+        for (int j = 0; j <= rt->maxx - rt->minx; ++j) {
+            int k = 0;
+            while (k < 3 && fixedEdges->values[k] + j * fixedEdges->dx[k] + i * fixedEdges->dy[k] > fixedEdges->thresholds[k])
+                ++k;
+            if (k == 3)
+                return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////
+/// Sets up everything the rasterizer needs
+/// to render the triangle made of the given
+/// shaded vertices, all of which must be
+/// inside the guard band.
+///
+/// Returns false if the triangle doesn't
+/// cover any pixels
+////////////////////////////////////////
+static bool setupTriangle(struct TXrasterTriangle* rt,
+                          struct TXdrawState* state,
+                          struct TXshadedVertex* v0,
+                          struct TXshadedVertex* v1,
+                          struct TXshadedVertex* v2)
+{
+    float* viewport_v0 = v0->windowPos;
+    float* viewport_v1 = v1->windowPos;
+    float* viewport_v2 = v2->windowPos;
+
+    int fbWidth  = state->framebufferWidth;
+    int fbHeight = state->framebufferHeight;
+
+    ////////////////////////////////////////
+    /// Pixels are sampled at integer coordinates,
+    /// so the bounding box only contains the pixels
+    /// whose sample is within the triangle's extents.
+    /// Snapping to subpixels may move a vertex by
+    /// half a subpixel, hence the margin.
+    ///
+    /// Triangles that fall between samples, which is
+    /// most of them in dense meshes, end up with an
+    /// empty bounding box and are dropped here
+    ////////////////////////////////////////
+    const float snapMargin = 0.5f / (float)TX_SUBPIXEL_SCALE;
+    rt->minx = (int)fmaxf(0.0f, ceilf(txMin3(viewport_v0[0],
+                                             viewport_v1[0],
+                                             viewport_v2[0]) - snapMargin));
+    rt->miny = (int)fmaxf(0.0f, ceilf(txMin3(viewport_v0[1],
+                                             viewport_v1[1],
+                                             viewport_v2[1]) - snapMargin));
+    rt->maxx = (int)floorf(fminf((float)fbWidth  - TX_FB_BIAS, txMax3(viewport_v0[0],
+                                                                      viewport_v1[0],
+                                                                      viewport_v2[0]) + snapMargin));
+    rt->maxy = (int)floorf(fminf((float)fbHeight - TX_FB_BIAS, txMax3(viewport_v0[1],
+                                                                      viewport_v1[1],
+                                                                      viewport_v2[1]) + snapMargin));
+
+    if (rt->minx > rt->maxx || rt->miny > rt->maxy)
+        return false;
+
+    ////////////////////////////////////////
+    //////////// EDGE FUNCTIONS ////////////
+    ////////////////////////////////////////
+    rt->isFixedPoint = txCanSnapToSubpixels(viewport_v0, viewport_v1, viewport_v2);
+    bool isCovered = rt->isFixedPoint ? txSetupFixedEdgeFunctions(&rt->fixedEdges,
+                                                                  &rt->edges,
+                                                                  viewport_v0,
+                                                                  viewport_v1,
+                                                                  viewport_v2,
+                                                                  rt->minx,
+                                                                  rt->miny)
+                                      : txSetupEdgeFunctions(&rt->edges,
+                                                             viewport_v0,
+                                                             viewport_v1,
+                                                             viewport_v2,
+                                                             rt->minx,
+                                                             rt->miny);
+    if (!isCovered)
+        return false;
+
+    if (rt->isFixedPoint &&
+        (rt->maxx - rt->minx + 1) * (rt->maxy - rt->miny + 1) <= TX_SMALL_TRIANGLE_PIXELS &&
+        !coversAnyPixel(rt))
+        return false;
+
+    rt->vertexInfo = state->vertexInfo;
+    rt->shadeModel = state->shadeModel;
+    txVec4Copy(rt->color, state->color);
+    rt->depthTest = state->depthTest;
+    rt->depthMask = state->depthMask;
+    rt->depthFunc = state->depthFunc;
+    rt->context = state->context;
+    rt->framebufferInfo = state->framebufferInfo;
+    rt->query = state->query;
+    rt->rasterizeBlock = state->rasterizeBlock;
+    rt->shader = state->shader;
+    rt->resolveSpan = state->resolveSpan;
+
+    rt->zValues[0] = v0->zValue;
+    rt->zValues[1] = v1->zValue;
+    rt->zValues[2] = v2->zValue;
+
+    txVec4Copy(rt->color0, v0->color);
+    txVec4Copy(rt->color1, v1->color);
+    txVec4Copy(rt->color2, v2->color);
+
+    txVec4Copy(rt->normal0, v0->normal);
+    txVec4Copy(rt->normal1, v1->normal);
+    txVec4Copy(rt->normal2, v2->normal);
+
+    txVec4Copy(rt->mvPos0, v0->viewPos);
+    txVec4Copy(rt->mvPos1, v1->viewPos);
+    txVec4Copy(rt->mvPos2, v2->viewPos);
+
+    ////////////////////////////////////////
+    /////////// ATTRIBUTE PLANES ///////////
+    ////////////////////////////////////////
+    if (state->attributePlanes & (1u << TX_COLOR_PLANE))
+        setupAttributePlane(&rt->planes[TX_COLOR_PLANE], &rt->edges, rt->zValues,
+                            v0->color, v1->color, v2->color);
+    if (state->attributePlanes & (1u << TX_NORMAL_PLANE))
+        setupAttributePlane(&rt->planes[TX_NORMAL_PLANE], &rt->edges, rt->zValues,
+                            v0->normal, v1->normal, v2->normal);
+    if (state->attributePlanes & (1u << TX_POSITION_PLANE))
+        setupAttributePlane(&rt->planes[TX_POSITION_PLANE], &rt->edges, rt->zValues,
+                            v0->viewPos, v1->viewPos, v2->viewPos);
+    return true;
+}
+
+////////////////////////////////////////
+/// Fragment shaders specialized for the
+/// VAO configurations and shade models that
+/// are implemented. TX_FS_GENERIC falls back
+/// to runFragmentShader. TX_FS_VISIBILITY doesn't
+/// shade at all, it records the triangle in the
+/// visibility buffer instead. TX_FS_DEPTH_ONLY
+/// doesn't even do that (see txColorMask).
+///
+/// The rasterizer is instantiated once for
+/// each of these and each depth state listed
+/// in TX_DEPTH_STATES, so that neither has to
+/// be looked at for every pixel
+////////////////////////////////////////
+#define TX_FRAGMENT_SHADERS(X) \
+    X(CONSTANT)                \
+    X(COLOR)                   \
+    X(LIT_FLAT)                \
+    X(LIT_SMOOTH)              \
+    X(COLOR_LIT_FLAT)          \
+    X(COLOR_LIT_SMOOTH)        \
+    X(GENERIC)                 \
+    X(VISIBILITY)              \
+    X(DEPTH_ONLY)
+
+////////////////////////////////////////
+/// X(SHADER, NAME, depthTest, depthFunc, depthMask)
+////////////////////////////////////////
+#define TX_DEPTH_STATES(X, SHADER)                              \
+    X(SHADER, NO_DEPTH_TEST,      false, TX_LESS,     false)    \
+    X(SHADER, LESS,               true,  TX_LESS,     true)     \
+    X(SHADER, LESS_READ_ONLY,     true,  TX_LESS,     false)    \
+    X(SHADER, LEQUAL,             true,  TX_LEQUAL,   true)     \
+    X(SHADER, LEQUAL_READ_ONLY,   true,  TX_LEQUAL,   false)    \
+    X(SHADER, EQUAL,              true,  TX_EQUAL,    true)     \
+    X(SHADER, EQUAL_READ_ONLY,    true,  TX_EQUAL,    false)    \
+    X(SHADER, GEQUAL,             true,  TX_GEQUAL,   true)     \
+    X(SHADER, GEQUAL_READ_ONLY,   true,  TX_GEQUAL,   false)    \
+    X(SHADER, GREATER,            true,  TX_GREATER,  true)     \
+    X(SHADER, GREATER_READ_ONLY,  true,  TX_GREATER,  false)    \
+    X(SHADER, NOTEQUAL,           true,  TX_NOTEQUAL, true)     \
+    X(SHADER, NOTEQUAL_READ_ONLY, true,  TX_NOTEQUAL, false)
+
+////////////////////////////////////////
+#define TX_FRAGMENT_SHADER_ENUM(SHADER) TX_FS_##SHADER,
+enum TXfragmentShader { TX_FRAGMENT_SHADERS(TX_FRAGMENT_SHADER_ENUM) TX_NUM_FRAGMENT_SHADERS };
+#undef TX_FRAGMENT_SHADER_ENUM
+
+////////////////////////////////////////
+#define TX_DEPTH_STATE_ENTRY(SHADER, NAME, DEPTH_TEST, DEPTH_FUNC, DEPTH_MASK) \
+    { DEPTH_TEST, DEPTH_FUNC, DEPTH_MASK },
+static const struct {
+    bool depthTest;
+    enum TXdepthFunc depthFunc;
+    bool depthMask;
+} depthStates[] = { TX_DEPTH_STATES(TX_DEPTH_STATE_ENTRY, _) };
+#undef TX_DEPTH_STATE_ENTRY
+
+////////////////////////////////////////
+#define TX_NUM_DEPTH_STATES ((int)(sizeof(depthStates) / sizeof(depthStates[0])))
+
+////////////////////////////////////////
+/// Returns the attribute planes (see
+/// TXdrawState::attributePlanes) the given
+/// fragment shader reads. TX_FS_GENERIC
+/// interpolates on its own
+////////////////////////////////////////
+TX_FORCE_INLINE unsigned getAttributePlanes(enum TXfragmentShader shader)
+{
+    switch (shader) {
+        case TX_FS_CONSTANT:
+        case TX_FS_LIT_FLAT:
+        case TX_FS_GENERIC:
+        case TX_FS_VISIBILITY:
+        case TX_FS_DEPTH_ONLY:
+        case TX_NUM_FRAGMENT_SHADERS:
+            return 0;
+        case TX_FS_COLOR:
+        case TX_FS_COLOR_LIT_FLAT:
+            return 1u << TX_COLOR_PLANE;
+        case TX_FS_LIT_SMOOTH:
+            return (1u << TX_NORMAL_PLANE) | (1u << TX_POSITION_PLANE);
+        case TX_FS_COLOR_LIT_SMOOTH:
+            return (1u << TX_COLOR_PLANE) | (1u << TX_NORMAL_PLANE) | (1u << TX_POSITION_PLANE);
+    }
+    return 0;
+}
+
+////////////////////////////////////////
+/// Turns the interpolated normal and
+/// position of a fragment into what
+/// applyLights expects
+////////////////////////////////////////
+TX_FORCE_INLINE void prepareLighting(TXvec4 normal, TXvec4 position, TXvec3 viewDir)
+{
+    txVec3Negate(viewDir, position);
+    txVec3Normalize(viewDir, viewDir);
+    txVec3Normalize(normal, normal);
+}
+
+////////////////////////////////////////
+TX_FORCE_INLINE void applyLights(TXvec4 outputColor, TXvec4 normal, TXvec4 position, TXvec3 viewDir)
+{
+    txComputeDirLight(outputColor,
+                      normal,
+                      viewDir);
+    txComputePointLight(outputColor,
+                        normal,
+                        position,
+                        viewDir);
+    txComputeSpotLight(outputColor,
+                       normal,
+                       position,
+                       viewDir);
+}
+
+////////////////////////////////////////
+/// Runs the fragment shader given by shader,
+/// which is a compile-time constant in each
+/// block rasterizer. attributes holds the
+/// interpolated attributes of the planes the
+/// shader reads (see getAttributePlanes), while
+/// weights are only used by TX_FS_GENERIC.
+/// flat{Normal,Position,ViewDir} and flatColor
+/// are set up by rasterizeBlock
+////////////////////////////////////////
+TX_FORCE_INLINE void shadeFragment(struct TXrasterTriangle* rt,
+                                   enum TXfragmentShader shader,
+                                   TXvec4 outputColor,
+                                   TXvec4 attributes[TX_NUM_ATTRIBUTE_PLANES],
+                                   TXvec3 weights,
+                                   float interpolatedZ,
+                                   TXvec4 flatNormal,
+                                   TXvec4 flatPosition,
+                                   TXvec3 flatViewDir,
+                                   TXvec4 flatColor)
+{
+    TXvec3 viewDir;
+
+    switch (shader) {
+        case TX_FS_CONSTANT:
+            txVec4Copy(outputColor, rt->color);
+            break;
+        case TX_FS_COLOR:
+            txVec4Copy(outputColor, attributes[TX_COLOR_PLANE]);
+            break;
+        case TX_FS_LIT_FLAT:
+            txVec4Copy(outputColor, flatColor);
+            break;
+        case TX_FS_LIT_SMOOTH:
+        case TX_FS_COLOR_LIT_SMOOTH:
+            if (shader == TX_FS_COLOR_LIT_SMOOTH)
+                txVec4Copy(outputColor, attributes[TX_COLOR_PLANE]);
+            else
+                txVec3Zero(outputColor);
+
+            prepareLighting(attributes[TX_NORMAL_PLANE], attributes[TX_POSITION_PLANE], viewDir);
+            applyLights(outputColor, attributes[TX_NORMAL_PLANE], attributes[TX_POSITION_PLANE], viewDir);
+            break;
+        case TX_FS_COLOR_LIT_FLAT:
+            txVec4Copy(outputColor, attributes[TX_COLOR_PLANE]);
+            applyLights(outputColor, flatNormal, flatPosition, flatViewDir);
+            break;
+        case TX_FS_GENERIC:
+            runFragmentShader(rt,
+                              outputColor,
+                              weights,
+                              interpolatedZ);
+            break;
+        case TX_FS_VISIBILITY:
+        case TX_FS_DEPTH_ONLY:
+        case TX_NUM_FRAGMENT_SHADERS:
+            break;
+    }
+}
+
+////////////////////////////////////////
+/// Flat shading lights every fragment with
+/// the same normal and position, so they
+/// are only prepared once. Without vertex
+/// colors, even the lit color is the same
+/// for every fragment
+////////////////////////////////////////
+TX_FORCE_INLINE void prepareFlatShading(struct TXrasterTriangle* rt,
+                                        enum TXfragmentShader shader,
+                                        TXvec4 flatNormal,
+                                        TXvec4 flatPosition,
+                                        TXvec3 flatViewDir,
+                                        TXvec4 flatColor)
+{
+    if (shader == TX_FS_LIT_FLAT || shader == TX_FS_COLOR_LIT_FLAT) {
+        txAverageVertexElement(flatNormal, rt->normal0, rt->normal1, rt->normal2);
+        txAverageVertexElement(flatPosition, rt->mvPos0, rt->mvPos1, rt->mvPos2);
+        prepareLighting(flatNormal, flatPosition, flatViewDir);
+
+        if (shader == TX_FS_LIT_FLAT) {
+            txVec3Zero(flatColor);
+            applyLights(flatColor, flatNormal, flatPosition, flatViewDir);
+        }
+    }
+}
+
+////////////////////////////////////////
+/// Body of every block rasterizer (see
+/// TXblockRasterizer). shader, depthTest,
+/// depthFunc and depthMask are compile-time
+/// constants in each of them, so the branches
+/// on them disappear from the inner loops
+////////////////////////////////////////
+TX_FORCE_INLINE unsigned rasterizeBlock(struct TXrasterTriangle* rt,
+                                        int x0,
+                                        int y0,
+                                        int x1,
+                                        int y1,
+                                        TXvec3 weights,
+                                        const int32_t fixedValues[3],
+                                        bool isCovered,
+                                        enum TXfragmentShader shader,
+                                        bool depthTest,
+                                        enum TXdepthFunc depthFunc,
+                                        bool depthMask)
+{
+    unsigned numPixels = 0;
+
+    ////////////////////////////////////////
+    /////// BARYCENTRIC COORDINATES ////////
+    ////////////////////////////////////////
+    TXvec3 rowWeights;
+    TXvec3 spanWeights;
+    TXvec3 fragmentWeights;
+    txVec3Copy(rowWeights, weights);
+
+    ////////////////////////////////////////
+    ///////// INTEGER EDGE FUNCTIONS ///////
+    ////////////////////////////////////////
+    const TXfixedEdgeFunctions_t* fixedEdges = rt->isFixedPoint ? &rt->fixedEdges : NULL;
+    int32_t rowValues[3] = { 0, 0, 0 };
+    int32_t spanValues[3];
+    int32_t spanValuesDx[3] = { 0, 0, 0 };
+    if (fixedEdges) {
+        for (int k = 0; k < 3; ++k) {
+            rowValues[k] = fixedValues[k];
+            spanValuesDx[k] = fixedEdges->dx[k] * TX_SPAN_WIDTH;
+        }
+    }
+
+    ////////////////////////////////////////
+    /////// OUTPUT COLOR OF THE PIXEL //////
+    ////////////////////////////////////////
+    TXvec4 outputColor = TX_VEC4_W1;
+
+    TXvec4 flatNormal   = TX_VEC4_ZERO;
+    TXvec4 flatPosition = TX_VEC4_W1;
+    TXvec3 flatViewDir  = { 0.0f, 0.0f, 0.0f };
+    TXvec4 flatColor    = TX_VEC4_W1;
+    prepareFlatShading(rt, shader, flatNormal, flatPosition, flatViewDir, flatColor);
+
+    ////////////////////////////////////////
+    /// Pixels are processed TX_SPAN_WIDTH at a
+    /// time: coverage and depth test happen in
+    /// txSpanCoverageDepth and only the pixels that
+    /// survive both are sent to the fragment shader
+    ////////////////////////////////////////
+    TXvec3 spanDx;
+    txVec3ScalarMul(spanDx, rt->edges.dx, (float)TX_SPAN_WIDTH);
+
+    ////////////////////////////////////////
+    /// Attribute planes are evaluated at (x0, y0)
+    /// and then stepped along rows and spans, so
+    /// a fragment only costs a multiply-add and
+    /// a multiplication by 1 / depth, shared by
+    /// every attribute, per component
+    ////////////////////////////////////////
+    const unsigned attributePlanes = getAttributePlanes(shader);
+    TXvec4 rowPlanes[TX_NUM_ATTRIBUTE_PLANES];
+    TXvec4 spanPlanes[TX_NUM_ATTRIBUTE_PLANES];
+    TXvec4 planesDx[TX_NUM_ATTRIBUTE_PLANES];
+    TXvec4 planesDy[TX_NUM_ATTRIBUTE_PLANES];
+    TXvec4 spanPlanesDx[TX_NUM_ATTRIBUTE_PLANES];
+    TXvec4 attributes[TX_NUM_ATTRIBUTE_PLANES];
+    for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p) {
+        if (!(attributePlanes & (1u << p)))
+            continue;
+        const struct TXattributePlane* plane = &rt->planes[p];
+        for (int c = 0; c < 4; ++c) {
+            rowPlanes[p][c] = plane->value[c] + (float)(x0 - rt->minx) * plane->dx[c]
+                                              + (float)(y0 - rt->miny) * plane->dy[c];
+            planesDx[p][c] = plane->dx[c];
+            planesDy[p][c] = plane->dy[c];
+            spanPlanesDx[p][c] = plane->dx[c] * (float)TX_SPAN_WIDTH;
+        }
+    }
+
+    TX_ALIGNED_BUFFER(float, depths, TX_SPAN_WIDTH, 32);
+
+    for (int i = y0; i <= y1; ++i, txVec3Add(rowWeights, rowWeights, rt->edges.dy)) {
+        txVec3Copy(spanWeights, rowWeights);
+        for (int k = 0; k < 3; ++k)
+            spanValues[k] = rowValues[k];
+        for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p)
+            if (attributePlanes & (1u << p))
+                txVec4Copy(spanPlanes[p], rowPlanes[p]);
+
+        for (int j = x0; j <= x1; j += TX_SPAN_WIDTH, txVec3Add(spanWeights, spanWeights, spanDx)) {
+            int count = x1 - j + 1 < TX_SPAN_WIDTH ? x1 - j + 1 : TX_SPAN_WIDTH;
+            TXpixel_t* pixels = getPixel(rt->context, i, j);
+
+            unsigned mask = txSpanCoverageDepth(spanWeights,
+                                                rt->edges.dx,
+                                                fixedEdges,
+                                                spanValues,
+                                                rt->zValues,
+                                                pixels,
+                                                count,
+                                                !isCovered,
+                                                depthTest,
+                                                depthFunc,
+                                                depths);
+            numPixels += txSpanCountPixels(mask);
+
+            for (int k = 0; k < 3; ++k)
+                spanValues[k] += spanValuesDx[k];
+
+            // Depth-only rasterization stops here
+            if (shader == TX_FS_DEPTH_ONLY) {
+                if (depthTest && depthMask) {
+                    for (int k = 0; mask; ++k, mask >>= 1)
+                        if (mask & 1u)
+                            pixels[k].depth = depths[k];
+                }
+                continue;
+            }
+
+            unsigned* ids = shader == TX_FS_VISIBILITY ? &rt->context->visibilityBuffer.ids[i * rt->context->visibilityBuffer.width + j] : NULL;
+
+            for (int k = 0; mask; ++k, mask >>= 1) {
+                if (!(mask & 1u))
+                    continue;
+
+                if (shader == TX_FS_GENERIC) {
+                    fragmentWeights[0] = spanWeights[0] + (float)k * rt->edges.dx[0];
+                    fragmentWeights[1] = spanWeights[1] + (float)k * rt->edges.dx[1];
+                    fragmentWeights[2] = spanWeights[2] + (float)k * rt->edges.dx[2];
+                }
+
+                if (attributePlanes) {
+                    float invZ = 1.0f / depths[k];
+                    for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p) {
+                        if (!(attributePlanes & (1u << p)))
+                            continue;
+                        for (int c = 0; c < 4; ++c)
+                            attributes[p][c] = (spanPlanes[p][c] + (float)k * planesDx[p][c]) * invZ;
+                    }
+                }
+
+                ////////////////////////////////////////
+                /////// FRAGMENT SHADER EMULATION //////
+                ////////////////////////////////////////
+                shadeFragment(rt,
+                                  shader,
+                                  outputColor,
+                                  attributes,
+                                  fragmentWeights,
+                                  depths[k],
+                                  flatNormal,
+                                  flatPosition,
+                                  flatViewDir,
+                                  flatColor);
+                ////////////////////////////////////////
+                /////// FRAGMENT SHADER COMPLETE ///////
+                ////////////////////////////////////////
+
+                if (shader == TX_FS_VISIBILITY) {
+                    ids[k] = rt->id;
+                } else {
+                    txVec4Clamp(outputColor, outputColor, 0.0f, 1.0f);
+                    txVec4Copy(pixels[k].color, outputColor);
+                }
+                if (depthTest && depthMask)
+                    pixels[k].depth = depths[k];
+            }
+
+            for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p)
+                if (attributePlanes & (1u << p))
+                    txVec4Add(spanPlanes[p], spanPlanes[p], spanPlanesDx[p]);
+        }
+
+        if (fixedEdges) {
+            for (int k = 0; k < 3; ++k)
+                rowValues[k] += fixedEdges->dy[k];
+        }
+        for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p)
+            if (attributePlanes & (1u << p))
+                txVec4Add(rowPlanes[p], rowPlanes[p], planesDy[p]);
+    }
+    return numPixels;
+}
+
+////////////////////////////////////////
+#define TX_DEFINE_BLOCK_RASTERIZER(SHADER, NAME, DEPTH_TEST, DEPTH_FUNC, DEPTH_MASK)              \
+    static unsigned rasterizeBlock_##SHADER##_##NAME(struct TXrasterTriangle* rt,                \
+                                                     int x0,                                     \
+                                                     int y0,                                     \
+                                                     int x1,                                     \
+                                                     int y1,                                     \
+                                                     TXvec3 weights,                             \
+                                                     const int32_t fixedValues[3],               \
+                                                     bool isCovered)                             \
+    {                                                                                            \
+        return rasterizeBlock(rt, x0, y0, x1, y1, weights, fixedValues, isCovered,               \
+                              TX_FS_##SHADER, DEPTH_TEST, DEPTH_FUNC, DEPTH_MASK);               \
+    }
+#define TX_DEFINE_BLOCK_RASTERIZERS(SHADER) TX_DEPTH_STATES(TX_DEFINE_BLOCK_RASTERIZER, SHADER)
+TX_FRAGMENT_SHADERS(TX_DEFINE_BLOCK_RASTERIZERS)
+#undef TX_DEFINE_BLOCK_RASTERIZERS
+#undef TX_DEFINE_BLOCK_RASTERIZER
+
+////////////////////////////////////////
+/// blockRasterizers[shader][depthState]
+/// where depthState indexes depthStates
+////////////////////////////////////////
+#define TX_BLOCK_RASTERIZER_ENTRY(SHADER, NAME, DEPTH_TEST, DEPTH_FUNC, DEPTH_MASK) \
+    rasterizeBlock_##SHADER##_##NAME,
+#define TX_BLOCK_RASTERIZER_ROW(SHADER) { TX_DEPTH_STATES(TX_BLOCK_RASTERIZER_ENTRY, SHADER) },
+static const TXblockRasterizer blockRasterizers[TX_NUM_FRAGMENT_SHADERS][TX_NUM_DEPTH_STATES] = {
+    TX_FRAGMENT_SHADERS(TX_BLOCK_RASTERIZER_ROW)
+};
+#undef TX_BLOCK_RASTERIZER_ROW
+#undef TX_BLOCK_RASTERIZER_ENTRY
+
+////////////////////////////////////////
+/// Body of every span resolver (see
+/// TXspanResolver). Barycentric coordinates,
+/// depth and attribute planes are evaluated
+/// from the triangle's edge functions, so the
+/// visibility buffer doesn't have to store them
+////////////////////////////////////////
+TX_FORCE_INLINE void resolveSpan(struct TXrasterTriangle* rt,
+                                 int y,
+                                 int x0,
+                                 int x1,
+                                 enum TXfragmentShader shader)
+{
+    TXvec3 weights;
+    for (int k = 0; k < 3; ++k)
+        weights[k] = rt->edges.weights[k] + (float)(x0 - rt->minx) * rt->edges.dx[k]
+                                          + (float)(y - rt->miny) * rt->edges.dy[k];
+
+    const unsigned attributePlanes = getAttributePlanes(shader);
+    TXvec4 planes[TX_NUM_ATTRIBUTE_PLANES];
+    TXvec4 attributes[TX_NUM_ATTRIBUTE_PLANES];
+    for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p) {
+        if (!(attributePlanes & (1u << p)))
+            continue;
+        const struct TXattributePlane* plane = &rt->planes[p];
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = plane->value[c] + (float)(x0 - rt->minx) * plane->dx[c]
+                                           + (float)(y - rt->miny) * plane->dy[c];
+    }
+
+    TXvec4 outputColor  = TX_VEC4_W1;
+    TXvec4 flatNormal   = TX_VEC4_ZERO;
+    TXvec4 flatPosition = TX_VEC4_W1;
+    TXvec3 flatViewDir  = { 0.0f, 0.0f, 0.0f };
+    TXvec4 flatColor    = TX_VEC4_W1;
+    prepareFlatShading(rt, shader, flatNormal, flatPosition, flatViewDir, flatColor);
+
+    TXpixel_t* pixels = getPixel(rt->context, y, x0);
+    for (int j = 0; j <= x1 - x0; ++j, txVec3Add(weights, weights, rt->edges.dx)) {
+        float depth = txVec3Dot(rt->zValues, weights);
+
+        if (attributePlanes) {
+            float invZ = 1.0f / depth;
+            for (int p = 0; p < TX_NUM_ATTRIBUTE_PLANES; ++p) {
+                if (!(attributePlanes & (1u << p)))
+                    continue;
+                txVec4ScalarMul(attributes[p], planes[p], invZ);
+                txVec4Add(planes[p], planes[p], rt->planes[p].dx);
+            }
+        }
+
+        shadeFragment(rt,
+                      shader,
+                      outputColor,
+                      attributes,
+                      weights,
+                      depth,
+                      flatNormal,
+                      flatPosition,
+                      flatViewDir,
+                      flatColor);
+
+        txVec4Clamp(outputColor, outputColor, 0.0f, 1.0f);
+        txVec4Copy(pixels[j].color, outputColor);
+    }
+}
+
+////////////////////////////////////////
+#define TX_DEFINE_SPAN_RESOLVER(SHADER)                                                \
+    static void resolveSpan_##SHADER(struct TXrasterTriangle* rt, int y, int x0, int x1) \
+    {                                                                                  \
+        resolveSpan(rt, y, x0, x1, TX_FS_##SHADER);                                    \
+    }
+TX_FRAGMENT_SHADERS(TX_DEFINE_SPAN_RESOLVER)
+#undef TX_DEFINE_SPAN_RESOLVER
+
+////////////////////////////////////////
+/// spanResolvers[shader]
+////////////////////////////////////////
+#define TX_SPAN_RESOLVER_ENTRY(SHADER) resolveSpan_##SHADER,
+static const TXspanResolver spanResolvers[TX_NUM_FRAGMENT_SHADERS] = {
+    TX_FRAGMENT_SHADERS(TX_SPAN_RESOLVER_ENTRY)
+};
+#undef TX_SPAN_RESOLVER_ENTRY
+
+////////////////////////////////////////
+static enum TXfragmentShader selectFragmentShader(enum TXvertexInfo vertexInfo, int model)
+{
+    switch (vertexInfo) {
+        case TX_POSITION:
+            return TX_FS_CONSTANT;
+        case TX_POSITION_COLOR:
+            return TX_FS_COLOR;
+        case TX_POSITION_NORMAL:
+            switch (model) {
+                case TX_UNLIT:
+                    return TX_FS_CONSTANT;
+                case TX_FLAT:
+                    return TX_FS_LIT_FLAT;
+                case TX_SMOOTH:
+                    return TX_FS_LIT_SMOOTH;
+            }
+            break;
+        case TX_POSITION_COLOR_NORMAL:
+            switch (model) {
+                case TX_UNLIT:
+                    return TX_FS_COLOR;
+                case TX_FLAT:
+                    return TX_FS_COLOR_LIT_FLAT;
+                case TX_SMOOTH:
+                    return TX_FS_COLOR_LIT_SMOOTH;
+            }
+            break;
+        case TX_POSITION_TEXCOORD:
+        case TX_POSITION_COLOR_TEXCOORD:
+        case TX_POSITION_NORMAL_TEXCOORD:
+        case TX_POSITION_COLOR_NORMAL_TEXCOORD:
+            break;
+    }
+    return TX_FS_GENERIC;
+}
+
+////////////////////////////////////////
+/// Picks the block rasterizer specialized
+/// for the given rasterizer state
+////////////////////////////////////////
+static TXblockRasterizer selectBlockRasterizer(enum TXfragmentShader shader,
+                                               bool depthTest,
+                                               enum TXdepthFunc depthFunc,
+                                               bool depthMask)
+{
+    int depthState = 0;
+    for (int i = 0; i < TX_NUM_DEPTH_STATES; ++i) {
+        if (depthStates[i].depthTest == depthTest &&
+            (!depthTest || (depthStates[i].depthFunc == depthFunc && depthStates[i].depthMask == depthMask))) {
+            depthState = i;
+            break;
+        }
+    }
+    return blockRasterizers[shader][depthState];
+}
+
+////////////////////////////////////////
+/// Adds numSamples to the result of query.
+/// In tiled mode the tiles of a triangle are
+/// rendered by different threads, whose
+/// writes are ordered by txRunJobs
+////////////////////////////////////////
+TX_FORCE_INLINE void addQuerySamples(TXquery_t* query, unsigned numSamples)
+{
+    __atomic_fetch_add(&query->samplesPassed, numSamples, __ATOMIC_RELAXED);
+}
+
+////////////////////////////////////////
+/// Returns true if all pixels of the block made
+/// of (width + 1) x (height + 1) pixels, whose
+/// top-left pixel has the integer edge functions
+/// values, are covered by the triangle.
+///
+/// Edge functions are linear, so each of them
+/// only has to be checked at the corner of the
+/// block where it's the smallest
+////////////////////////////////////////
+TX_FORCE_INLINE bool isBlockInsideTriangle(const TXfixedEdgeFunctions_t* fixedEdges,
+                                           const int32_t values[3],
+                                           int width,
+                                           int height)
+{
+    for (int k = 0; k < 3; ++k) {
+        int64_t minValue = values[k];
+        if (fixedEdges->dx[k] < 0)
+            minValue += (int64_t)fixedEdges->dx[k] * width;
+        if (fixedEdges->dy[k] < 0)
+            minValue += (int64_t)fixedEdges->dy[k] * height;
+        if (minValue <= fixedEdges->thresholds[k])
+            return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+/// Rasterizes the part of a set-up triangle
+/// that falls inside the rectangle given by
+/// [minx, maxx] x [miny, maxy].
+///
+/// The rectangle is walked in tiles of the
+/// hierarchical depth buffer. Since depth is
+/// affine in screen-space, its range over a
+/// tile is known from the tile's corners, so
+/// tiles where the triangle is hidden are
+/// rejected before touching a single pixel
+////////////////////////////////////////
+static void rasterizeTriangle(struct TXrasterTriangle* rt,
+                              int minx,
+                              int miny,
+                              int maxx,
+                              int maxy)
+{
+    minx = minx > rt->minx ? minx : rt->minx;
+    miny = miny > rt->miny ? miny : rt->miny;
+    maxx = maxx < rt->maxx ? maxx : rt->maxx;
+    maxy = maxy < rt->maxy ? maxy : rt->maxy;
+
+    TXframebufferInfo_t* framebufferInfo = rt->framebufferInfo;
+    bool useHiZ = rt->depthTest && framebufferInfo && framebufferInfo->hiZ[framebufferInfo->currentFramebuffer];
+
+    float dzdx = txVec3Dot(rt->zValues, rt->edges.dx);
+    float dzdy = txVec3Dot(rt->zValues, rt->edges.dy);
+
+    float triMinDepth = txMin3(rt->zValues[0], rt->zValues[1], rt->zValues[2]);
+    float triMaxDepth = txMax3(rt->zValues[0], rt->zValues[1], rt->zValues[2]);
+    float depthBias = TX_HIZ_BIAS * fmaxf(1.0f, fmaxf(fabsf(triMinDepth), fabsf(triMaxDepth)));
+    triMinDepth -= depthBias;
+    triMaxDepth += depthBias;
+
+    unsigned numPixels = 0;
+    TXvec3 weights;
+    int32_t fixedValues[3] = { 0, 0, 0 };
+    for (int ty = miny - miny % TX_HIZ_TILE_SIZE; ty <= maxy; ty += TX_HIZ_TILE_SIZE) {
+        int y0 = ty > miny ? ty : miny;
+        int y1 = ty + TX_HIZ_TILE_SIZE - 1 < maxy ? ty + TX_HIZ_TILE_SIZE - 1 : maxy;
+
+        for (int tx = minx - minx % TX_HIZ_TILE_SIZE; tx <= maxx; tx += TX_HIZ_TILE_SIZE) {
+            int x0 = tx > minx ? tx : minx;
+            int x1 = tx + TX_HIZ_TILE_SIZE - 1 < maxx ? tx + TX_HIZ_TILE_SIZE - 1 : maxx;
+
+            for (int k = 0; k < 3; ++k)
+                weights[k] = rt->edges.weights[k] + (float)(x0 - rt->minx) * rt->edges.dx[k]
+                                                  + (float)(y0 - rt->miny) * rt->edges.dy[k];
+            if (rt->isFixedPoint) {
+                for (int k = 0; k < 3; ++k)
+                    fixedValues[k] = rt->fixedEdges.values[k] + (x0 - rt->minx) * rt->fixedEdges.dx[k]
+                                                              + (y0 - rt->miny) * rt->fixedEdges.dy[k];
+            }
+
+            TXhiZTile_t* tile = useHiZ ? txGetHiZTileFromCurrentFramebuffer(framebufferInfo, y0, x0) : NULL;
+            if (tile) {
+                float depth = txVec3Dot(rt->zValues, weights);
+                float width  = (float)(x1 - x0);
+                float height = (float)(y1 - y0);
+
+                float tileMinDepth = depth + fminf(0.0f, dzdx * width) + fminf(0.0f, dzdy * height) - depthBias;
+                float tileMaxDepth = depth + fmaxf(0.0f, dzdx * width) + fmaxf(0.0f, dzdy * height) + depthBias;
+
+                if (txHiZRejects(rt->depthFunc,
+                                 tile,
+                                 fmaxf(tileMinDepth, triMinDepth),
+                                 fminf(tileMaxDepth, triMaxDepth)))
+                    continue;
+            }
+
+            // Blocks deep inside of large triangles
+            // are filled without testing coverage
+            bool isCovered = rt->isFixedPoint && isBlockInsideTriangle(&rt->fixedEdges,
+                                                                       fixedValues,
+                                                                       x1 - x0,
+                                                                       y1 - y0);
+
+            unsigned blockPixels = rt->rasterizeBlock(rt, x0, y0, x1, y1, weights, fixedValues, isCovered);
+            if (blockPixels && tile && rt->depthMask)
+                txUpdateHiZTile(framebufferInfo, y0, x0);
+            numPixels += blockPixels;
+        }
+    }
+
+    if (rt->query && numPixels)
+        addQuerySamples(rt->query, numPixels);
+}
+
+////////////////////////////////////////
+/////////// VISIBILITY BUFFER //////////
+////////////////////////////////////////
+
+////////////////////////////////////////
+/// Makes sure the visibility buffer is as
+/// large as the framebuffer. Returns false
+/// if out of memory
+////////////////////////////////////////
+static bool reserveVisibilityBuffer(TXcontext_t* context)
+{
+    int width  = getFramebufferWidth(context);
+    int height = getFramebufferHeight(context);
+    if (context->visibilityBuffer.ids && context->visibilityBuffer.width == width && context->visibilityBuffer.height == height)
+        return true;
+
+    free(context->visibilityBuffer.ids);
+    context->visibilityBuffer.ids = (unsigned*)calloc((unsigned)(width * height), sizeof(unsigned));
+    context->visibilityBuffer.width  = context->visibilityBuffer.ids ? width  : 0;
+    context->visibilityBuffer.height = context->visibilityBuffer.ids ? height : 0;
+    return context->visibilityBuffer.ids != NULL;
+}
+
+////////////////////////////////////////
+/// Shades the pixels of [minx, maxx] x [miny, maxy]
+/// recorded in the visibility buffer with the
+/// triangles they were recorded with, and clears
+/// them. Consecutive pixels of a row that belong
+/// to the same triangle are shaded together
+////////////////////////////////////////
+static void resolveVisibilityBuffer(const struct TXtriangleBatch* batch, int minx, int miny, int maxx, int maxy)
+{
+    const TXcontext_t* context = batch->context;
+    for (int i = miny; i <= maxy; ++i) {
+        unsigned* ids = &context->visibilityBuffer.ids[i * context->visibilityBuffer.width];
+        for (int j = minx; j <= maxx;) {
+            unsigned id = ids[j];
+            if (!id) {
+                ++j;
+                continue;
+            }
+
+            int x0 = j;
+            while (j <= maxx && ids[j] == id)
+                ids[j++] = 0;
+
+            struct TXrasterTriangle* rt = &batch->triangles[id - 1];
+            rt->resolveSpan(rt, i, x0, j - 1);
+        }
+    }
+}
+
+////////////////////////////////////////
+/// Runs both passes of the visibility buffer
+/// over the whole framebuffer on the calling
+/// thread, for when tiled rendering is off
+////////////////////////////////////////
+static void renderVisibilityBuffer(const struct TXtriangleBatch* batch)
+{
+    const TXcontext_t* context = batch->context;
+    int minx = INT_MAX, miny = INT_MAX;
+    int maxx = INT_MIN, maxy = INT_MIN;
+    for (int i = 0; i < batch->numTriangles; ++i) {
+        struct TXrasterTriangle* rt = &batch->triangles[i];
+        rasterizeTriangle(rt, 0, 0, context->visibilityBuffer.width - 1, context->visibilityBuffer.height - 1);
+
+        minx = rt->minx < minx ? rt->minx : minx;
+        miny = rt->miny < miny ? rt->miny : miny;
+        maxx = rt->maxx > maxx ? rt->maxx : maxx;
+        maxy = rt->maxy > maxy ? rt->maxy : maxy;
+    }
+    resolveVisibilityBuffer(batch, minx, miny, maxx, maxy);
+}
+
+////////////////////////////////////////
+void txEnableVisibilityBuffer()
+{
+    // Triangles submitted so far are
+    // shaded the way they were set up
+    txFinish();
+    currentState->context->visibilityBuffer.enabled = true;
+}
+
+////////////////////////////////////////
+void txDisableVisibilityBuffer()
+{
+    TXcontext_t* context = currentState->context;
+    if (!context->visibilityBuffer.enabled)
+        return;
+
+    txFinish();
+    free(context->visibilityBuffer.ids);
+    memset(&context->visibilityBuffer, 0, sizeof(context->visibilityBuffer));
+
+    if (!context->tiler.enabled && !context->renderThread.enabled) {
+        free(context->tiler.batch.triangles);
+        memset(&context->tiler.batch, 0, sizeof(context->tiler.batch));
+        context->tiler.batch.context = context;
+    }
+}
+
+////////////////////////////////////////
+bool txIsVisibilityBufferEnabled()
+{
+    return currentState->context->visibilityBuffer.enabled;
+}
+
+////////////////////////////////////////
+/////////// TILED RENDERING ////////////
+////////////////////////////////////////
+
+////////////////////////////////////////
+static void renderTile(void* userData, int tile, int threadIndex)
+{
+    const struct TXtriangleBatch* batch = (const struct TXtriangleBatch*)userData;
+    const TXcontext_t* context = batch->context;
+    (void)threadIndex;
+
+    int minx = (tile % context->tiler.numTilesX) * TX_TILE_SIZE;
+    int miny = (tile / context->tiler.numTilesX) * TX_TILE_SIZE;
+    int maxx = minx + TX_TILE_SIZE - 1;
+    int maxy = miny + TX_TILE_SIZE - 1;
+
+    for (int i = context->tiler.binOffsets[tile]; i < context->tiler.binOffsets[tile + 1]; ++i) {
+        struct TXrasterTriangle* rt = &batch->triangles[context->tiler.binIndices[i]];
+        rasterizeTriangle(rt, minx, miny, maxx, maxy);
+    }
+
+    if (context->visibilityBuffer.enabled && context->tiler.binOffsets[tile] < context->tiler.binOffsets[tile + 1]) {
+        maxx = maxx < context->visibilityBuffer.width  ? maxx : context->visibilityBuffer.width  - 1;
+        maxy = maxy < context->visibilityBuffer.height ? maxy : context->visibilityBuffer.height - 1;
+        resolveVisibilityBuffer(batch, minx, miny, maxx, maxy);
+    }
+}
+
+////////////////////////////////////////
+/// Sorts binned triangles into per-tile
+/// bins. Returns false if out of memory
+////////////////////////////////////////
+static bool binTriangles(const struct TXtriangleBatch* batch)
+{
+    TXcontext_t* context = batch->context;
+    context->tiler.numTilesX = (getFramebufferWidth(context)  + TX_TILE_SIZE - 1) / TX_TILE_SIZE;
+    context->tiler.numTilesY = (getFramebufferHeight(context) + TX_TILE_SIZE - 1) / TX_TILE_SIZE;
+    int numTiles = context->tiler.numTilesX * context->tiler.numTilesY;
+
+    if (numTiles + 1 > context->tiler.maxTiles) {
+        int* binOffsets = (int*)realloc(context->tiler.binOffsets, (unsigned)(numTiles + 1) * sizeof(int));
+        if (!binOffsets)
+            return false;
+        context->tiler.binOffsets = binOffsets;
+        context->tiler.maxTiles = numTiles + 1;
+    }
+    memset(context->tiler.binOffsets, 0, (unsigned)(numTiles + 1) * sizeof(int));
+
+    // First count the triangles of each tile...
+    int numBinIndices = 0;
+    for (int i = 0; i < batch->numTriangles; ++i) {
+        struct TXrasterTriangle* rt = &batch->triangles[i];
+        for (int ty = rt->miny / TX_TILE_SIZE; ty <= rt->maxy / TX_TILE_SIZE; ++ty) {
+            for (int tx = rt->minx / TX_TILE_SIZE; tx <= rt->maxx / TX_TILE_SIZE; ++tx) {
+                if (tx < context->tiler.numTilesX && ty < context->tiler.numTilesY) {
+                    ++context->tiler.binOffsets[ty * context->tiler.numTilesX + tx + 1];
+                    ++numBinIndices;
+                }
+            }
+        }
+    }
+
+    if (numBinIndices > context->tiler.maxBinIndices) {
+        int* binIndices = (int*)realloc(context->tiler.binIndices, (unsigned)numBinIndices * sizeof(int));
+        if (!binIndices)
+            return false;
+        context->tiler.binIndices = binIndices;
+        context->tiler.maxBinIndices = numBinIndices;
+    }
+
+    // ...then turn counts into offsets...
+    for (int t = 0; t < numTiles; ++t)
+        context->tiler.binOffsets[t + 1] += context->tiler.binOffsets[t];
+
+    // ...and finally fill the bins, using
+    // binOffsets[t] as a cursor that ends up
+    // where bin t + 1 begins
+    for (int i = 0; i < batch->numTriangles; ++i) {
+        struct TXrasterTriangle* rt = &batch->triangles[i];
+        for (int ty = rt->miny / TX_TILE_SIZE; ty <= rt->maxy / TX_TILE_SIZE; ++ty) {
+            for (int tx = rt->minx / TX_TILE_SIZE; tx <= rt->maxx / TX_TILE_SIZE; ++tx) {
+                if (tx < context->tiler.numTilesX && ty < context->tiler.numTilesY)
+                    context->tiler.binIndices[context->tiler.binOffsets[ty * context->tiler.numTilesX + tx]++] = i;
+            }
+        }
+    }
+    for (int t = numTiles; t > 0; --t)
+        context->tiler.binOffsets[t] = context->tiler.binOffsets[t - 1];
+    context->tiler.binOffsets[0] = 0;
+
+    return true;
+}
+
+////////////////////////////////////////
+bool txEnableTiledRendering(int numThreads)
+{
+    TXcontext_t* context = currentState->context;
+    if (context->tiler.enabled)
+        txDisableTiledRendering();
+    else
+        txFinish();
+
+    if (numThreads <= 0)
+        numThreads = txGetNumCores();
+
+    // The calling thread works on tiles too
+    if (!txCreateThreadPool(&context->tiler.pool, numThreads - 1)) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableTiledRendering: couldn't create %d worker threads", numThreads - 1);
+        return false;
+    }
+
+    context->tiler.enabled = true;
+    return true;
+}
+
+////////////////////////////////////////
+void txDisableTiledRendering()
+{
+    TXcontext_t* context = currentState->context;
+    if (!context->tiler.enabled)
+        return;
+
+    txFinish();
+    txDestroyThreadPool(&context->tiler.pool);
+
+    struct TXtriangleBatch batch = context->tiler.batch;
+
+    free(context->tiler.binOffsets);
+    free(context->tiler.binIndices);
+    memset(&context->tiler, 0, sizeof(context->tiler));
+    context->tiler.batch.context = context;
+
+    if (context->visibilityBuffer.enabled || context->renderThread.enabled)
+        context->tiler.batch = batch;
+    else
+        free(batch.triangles);
+}
+
+////////////////////////////////////////
+bool txIsTiledRenderingEnabled()
+{
+    return currentState->context->tiler.enabled;
+}
+
+////////////////////////////////////////
+/// Renders a batch of deferred triangles
+/// and empties it
+////////////////////////////////////////
+static void renderBatch(struct TXtriangleBatch* batch)
+{
+    TXcontext_t* context = batch->context;
+    if (context->visibilityBuffer.enabled && !reserveVisibilityBuffer(context)) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txFlush: out of memory while allocating the visibility buffer");
+    } else if (context->tiler.enabled) {
+        if (binTriangles(batch))
+            txRunJobs(&context->tiler.pool, renderTile, batch, context->tiler.numTilesX * context->tiler.numTilesY);
+        else
+            txOutputMessage(TX_ERROR, "[CursedGL] txFlush: out of memory while binning %d triangles", batch->numTriangles);
+    } else if (context->visibilityBuffer.enabled) {
+        renderVisibilityBuffer(batch);
+    } else {
+        for (int i = 0; i < batch->numTriangles; ++i)
+            rasterizeTriangle(&batch->triangles[i], 0, 0, getFramebufferWidth(context) - 1, getFramebufferHeight(context) - 1);
+    }
+
+    batch->numTriangles = 0;
+    __atomic_fetch_add(&context->numRenderedBatches, 1, __ATOMIC_RELEASE);
+}
+
+////////////////////////////////////////
+//////////// RENDER THREAD /////////////
+////////////////////////////////////////
+
+////////////////////////////////////////
+static void renderBatchCommand(void* userData)
+{
+    struct TXtriangleBatch* batch = (struct TXtriangleBatch*)userData;
+    renderBatch(batch);
+
+    // freeBatches has room for every batch
+    txPushCommand(&batch->context->renderThread.freeBatches, NULL, batch);
+}
+
+////////////////////////////////////////
+static void endFrameCommand(void* userData)
+{
+    TXcontext_t* context = (TXcontext_t*)userData;
+    sem_post(&context->renderThread.frameSlots);
+}
+
+////////////////////////////////////////
+static void finishCommand(void* userData)
+{
+    TXcontext_t* context = (TXcontext_t*)userData;
+    sem_post(&context->renderThread.finished);
+}
+
+////////////////////////////////////////
+/// Executes commands in order until
+/// it gets one without a callback
+////////////////////////////////////////
+static void* renderThreadMain(void* arg)
+{
+    TXcontext_t* context = (TXcontext_t*)arg;
+
+    struct TXcommand command;
+    for (txPopCommand(&context->renderThread.commands, &command);
+         command.callback;
+         txPopCommand(&context->renderThread.commands, &command))
+        command.callback(command.userData);
+    return NULL;
+}
+
+////////////////////////////////////////
+void txFlush()
+{
+    if (isRecording("txFlush"))
+        return;
+
+    TXcontext_t* context = currentState->context;
+    if (!context->tiler.batch.numTriangles)
+        return;
+    ++context->numFlushes;
+
+    if (!context->renderThread.enabled) {
+        renderBatch(&context->tiler.batch);
+        return;
+    }
+
+    // Hand the triangles over to the render thread
+    // and keep recording into the array of a batch
+    // it's done with, waiting for one if needed
+    struct TXcommand freeBatch;
+    txPopCommand(&context->renderThread.freeBatches, &freeBatch);
+
+    struct TXtriangleBatch* batch = (struct TXtriangleBatch*)freeBatch.userData;
+    struct TXtriangleBatch recorded = context->tiler.batch;
+    context->tiler.batch = *batch;
+    *batch = recorded;
+
+    txPushCommand(&context->renderThread.commands, renderBatchCommand, batch);
+}
+
+////////////////////////////////////////
+/// Frees the batches of the render thread
+/// and destroys both of its queues
+////////////////////////////////////////
+static void destroyRenderThreadQueues(TXcontext_t* context)
+{
+    for (int i = 0; i < TX_RENDER_THREAD_BATCHES; ++i)
+        free(context->renderThread.batches[i].triangles);
+    free(context->renderThread.batches);
+
+    txDestroyCommandQueue(&context->renderThread.freeBatches);
+    txDestroyCommandQueue(&context->renderThread.commands);
+}
+
+////////////////////////////////////////
+bool txEnableRenderThread(int maxFramesInFlight)
+{
+    TXcontext_t* context = currentState->context;
+    if (context->renderThread.enabled)
+        txDisableRenderThread();
+    else
+        txFlush();
+
+    if (maxFramesInFlight < 1)
+        maxFramesInFlight = 1;
+
+    context->renderThread.batches = (struct TXtriangleBatch*)calloc(TX_RENDER_THREAD_BATCHES, sizeof(struct TXtriangleBatch));
+    if (!context->renderThread.batches) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableRenderThread: out of memory");
+        return false;
+    }
+    if (!txCreateCommandQueue(&context->renderThread.commands, TX_RENDER_THREAD_COMMANDS)) {
+        free(context->renderThread.batches);
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableRenderThread: couldn't create the command queue");
+        return false;
+    }
+    if (!txCreateCommandQueue(&context->renderThread.freeBatches, TX_RENDER_THREAD_BATCHES)) {
+        txDestroyCommandQueue(&context->renderThread.commands);
+        free(context->renderThread.batches);
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableRenderThread: couldn't create the command queue");
+        return false;
+    }
+    for (int i = 0; i < TX_RENDER_THREAD_BATCHES; ++i) {
+        context->renderThread.batches[i].context = context;
+        txPushCommand(&context->renderThread.freeBatches, NULL, &context->renderThread.batches[i]);
+    }
+
+    if (sem_init(&context->renderThread.frameSlots, 0, (unsigned)maxFramesInFlight)) {
+        destroyRenderThreadQueues(context);
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableRenderThread: couldn't allow %d frames in flight", maxFramesInFlight);
+        return false;
+    }
+    if (sem_init(&context->renderThread.finished, 0, 0)) {
+        sem_destroy(&context->renderThread.frameSlots);
+        destroyRenderThreadQueues(context);
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableRenderThread: couldn't create a semaphore");
+        return false;
+    }
+
+    if (pthread_create(&context->renderThread.thread, NULL, renderThreadMain, context)) {
+        sem_destroy(&context->renderThread.finished);
+        sem_destroy(&context->renderThread.frameSlots);
+        destroyRenderThreadQueues(context);
+        txOutputMessage(TX_ERROR, "[CursedGL] txEnableRenderThread: couldn't create the render thread");
+        return false;
+    }
+
+    context->renderThread.enabled = true;
+    return true;
+}
+
+////////////////////////////////////////
+void txDisableRenderThread()
+{
+    TXcontext_t* context = currentState->context;
+    if (!context->renderThread.enabled)
+        return;
+
+    txFinish();
+    txPushCommand(&context->renderThread.commands, NULL, NULL);
+    pthread_join(context->renderThread.thread, NULL);
+
+    sem_destroy(&context->renderThread.finished);
+    sem_destroy(&context->renderThread.frameSlots);
+    destroyRenderThreadQueues(context);
+    memset(&context->renderThread, 0, sizeof(context->renderThread));
+
+    if (!context->tiler.enabled && !context->visibilityBuffer.enabled) {
+        free(context->tiler.batch.triangles);
+        memset(&context->tiler.batch, 0, sizeof(context->tiler.batch));
+        context->tiler.batch.context = context;
+    }
+}
+
+////////////////////////////////////////
+bool txIsRenderThreadEnabled()
+{
+    return currentState->context->renderThread.enabled;
+}
+
+////////////////////////////////////////
+void txSubmitCommand(TXcommandCallback callback, void* userData)
+{
+    if (isRecording("txSubmitCommand"))
+        return;
+
+    if (!callback)
+        return;
+
+    txFlush();
+    TXcontext_t* context = currentState->context;
+    if (context->renderThread.enabled)
+        txPushCommand(&context->renderThread.commands, callback, userData);
+    else
+        callback(userData);
+}
+
+////////////////////////////////////////
+void txSubmitFrame(TXcommandCallback present, void* userData)
+{
+    TXcontext_t* context = currentState->context;
+    if (!context->renderThread.enabled) {
+        txSubmitCommand(present, userData);
+        return;
+    }
+
+    txWaitSemaphore(&context->renderThread.frameSlots);
+    txSubmitCommand(present, userData);
+    txPushCommand(&context->renderThread.commands, endFrameCommand, context);
+}
+
+////////////////////////////////////////
+void txFinish()
+{
+    if (isRecording("txFinish"))
+        return;
+
+    txFlush();
+    TXcontext_t* context = currentState->context;
+    if (!context->renderThread.enabled)
+        return;
+
+    txPushCommand(&context->renderThread.commands, finishCommand, context);
+    txWaitSemaphore(&context->renderThread.finished);
+}
+
+////////////////////////////////////////
+/////////// OCCLUSION QUERIES //////////
+////////////////////////////////////////
+
+////////////////////////////////////////
+void txInitQuery(TXquery_t* query)
+{
+    query->samplesPassed = 0;
+    query->numBatches = 0;
+    query->context = NULL;
+}
+
+////////////////////////////////////////
+void txBeginQuery(TXquery_t* query, enum TXqueryMode mode)
+{
+    if (isRecording("txBeginQuery"))
+        return;
+
+    if (currentState->activeQuery.query) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txBeginQuery: another query is already active");
+        return;
+    }
+
+    // Triangles of the previous use of query
+    // must not count towards the new one
+    if (!txIsQueryResultAvailable(query)) {
+        if (query->context != currentState->context) {
+            txOutputMessage(TX_WARNING, "[CursedGL] txBeginQuery: query is still pending on another context");
+            return;
+        }
+        txFinish();
+    }
+
+    query->samplesPassed = 0;
+    query->numBatches = 0;
+    query->context = currentState->context;
+
+    currentState->activeQuery.query = query;
+    currentState->activeQuery.mode = mode;
+}
+
+////////////////////////////////////////
+void txEndQuery()
+{
+    if (!currentState->activeQuery.query) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txEndQuery: no query is active");
+        return;
+    }
+
+    // Triangles that haven't been flushed
+    // yet go into the next batch
+    const TXcontext_t* context = currentState->context;
+    currentState->activeQuery.query->numBatches = context->numFlushes + (context->tiler.batch.numTriangles > 0 ? 1u : 0u);
+    currentState->activeQuery.query = NULL;
+}
+
+////////////////////////////////////////
+bool txIsQueryResultAvailable(TXquery_t* query)
+{
+    if (!query->context)
+        return true;
+    return __atomic_load_n(&query->context->numRenderedBatches, __ATOMIC_ACQUIRE) >= query->numBatches;
+}
+
+////////////////////////////////////////
+unsigned txGetQueryResult(TXquery_t* query)
+{
+    if (!txIsQueryResultAvailable(query)) {
+        if (query->context != currentState->context) {
+            txOutputMessage(TX_WARNING, "[CursedGL] txGetQueryResult: query is pending on another context");
+            return 0;
+        }
+        txFinish();
+    }
+    return query->samplesPassed;
+}
+
+////////////////////////////////////////
+////////////// CONTEXTS ////////////////
+////////////////////////////////////////
+
+////////////////////////////////////////
+TXcontext_t* txCreateContext(TXframebufferInfo_t* framebufferInfo)
+{
+    TXcontext_t* context = (TXcontext_t*)calloc(1, sizeof(TXcontext_t));
+    if (!context) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txCreateContext: out of memory");
+        return NULL;
+    }
+    context->state = (struct TXrasterState)TX_INITIAL_RASTER_STATE(context);
+    context->tiler.batch.context = context;
+    context->framebufferInfo = framebufferInfo;
+    return context;
+}
+
+////////////////////////////////////////
+void txDestroyContext(TXcontext_t* context)
+{
+    if (!context)
+        return;
+    if (context == &defaultContext) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txDestroyContext: the default context can't be destroyed");
+        return;
+    }
+
+    // The functions below act on the
+    // current context of this thread
+    struct TXrasterState* previousState = currentState;
+    currentState = &context->state;
+
+    txDisableRenderThread();
+    txDisableTiledRendering();
+    txDisableVisibilityBuffer();
+
+    free(context->state.vertexCache.stamps);
+    free(context->state.vertexCache.vertices);
+    free(context->tiler.batch.triangles);
+
+    currentState = previousState->context == context ? &defaultContext.state : previousState;
+    free(context);
+}
+
+////////////////////////////////////////
+void txMakeContextCurrent(TXcontext_t* context)
+{
+    if (isRecording("txMakeContextCurrent"))
+        return;
+    currentState = context ? &context->state : &defaultContext.state;
+}
+
+////////////////////////////////////////
+TXcontext_t* txGetCurrentContext()
+{
+    return currentState->context;
+}
+
+////////////////////////////////////////
+void txBindFramebuffer(TXframebufferInfo_t* framebufferInfo)
+{
+    if (isRecording("txBindFramebuffer"))
+        return;
+
+    // Deferred triangles look the framebuffer
+    // up when they're rendered
+    txFinish();
+    currentState->context->framebufferInfo = framebufferInfo;
+}
+
+////////////////////////////////////////
+TXframebufferInfo_t* txGetBoundFramebuffer()
+{
+    return currentState->context->framebufferInfo;
+}
+
+////////////////////////////////////////
+void txResetState()
+{
+    if (isRecording("txResetState"))
+        return;
+
+    if (currentState->activeQuery.query)
+        txEndQuery();
+
+    // The vertex cache only holds
+    // storage, not state
+    struct TXvertexCache vertexCache = currentState->vertexCache;
+    *currentState = (struct TXrasterState)TX_INITIAL_RASTER_STATE(currentState->context);
+    currentState->vertexCache = vertexCache;
+}
+
+////////////////////////////////////////
+/////////// COMMAND BUFFERS ////////////
+////////////////////////////////////////
+
+////////////////////////////////////////
+/// See TXcommandBuffer_t in rasterizer.h
+////////////////////////////////////////
+struct TXcommandBuffer {
+    struct TXrasterState state;
+    struct TXtriangleBatch batch;
+
+    // Framebuffer the triangles of batch were
+    // set up for, see txBeginCommandBuffer
+    TXframebufferInfo_t* framebufferInfo;
+    int framebufferWidth;
+    int framebufferHeight;
+};
+
+////////////////////////////////////////
+/// Makes room for numTriangles more triangles
+/// in batch. Returns false if out of memory
+////////////////////////////////////////
+static bool reserveTriangles(struct TXtriangleBatch* batch, int numTriangles)
+{
+    if (batch->numTriangles + numTriangles > batch->maxTriangles) {
+        int maxTriangles = batch->maxTriangles ? batch->maxTriangles : 1024;
+        while (maxTriangles < batch->numTriangles + numTriangles)
+            maxTriangles *= 2;
+
+        struct TXrasterTriangle* triangles = (struct TXrasterTriangle*)realloc(batch->triangles,
+                                                                               (unsigned)maxTriangles * sizeof(struct TXrasterTriangle));
+        if (!triangles)
+            return false;
+        batch->triangles = triangles;
+        batch->maxTriangles = maxTriangles;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+/// Picks the block rasterizer of a recorded
+/// triangle for the current state of the
+/// visibility buffer
+////////////////////////////////////////
+TX_FORCE_INLINE void reselectBlockRasterizer(struct TXrasterTriangle* rt, bool visibilityBuffer)
+{
+    enum TXfragmentShader shader = (enum TXfragmentShader)rt->shader;
+    bool writesColor = shader != TX_FS_DEPTH_ONLY;
+    rt->rasterizeBlock = selectBlockRasterizer(visibilityBuffer && writesColor ? TX_FS_VISIBILITY : shader,
+                                               rt->depthTest,
+                                               rt->depthFunc,
+                                               rt->depthMask);
+}
+
+////////////////////////////////////////
+TXcommandBuffer_t* txCreateCommandBuffer()
+{
+    TXcommandBuffer_t* buffer = (TXcommandBuffer_t*)calloc(1, sizeof(TXcommandBuffer_t));
+    if (!buffer) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txCreateCommandBuffer: out of memory");
+        return NULL;
+    }
+    txResetCommandBuffer(buffer);
+    return buffer;
+}
+
+////////////////////////////////////////
+void txFreeCommandBuffer(TXcommandBuffer_t* buffer)
+{
+    if (!buffer)
+        return;
+
+    free(buffer->state.vertexCache.stamps);
+    free(buffer->state.vertexCache.vertices);
+    free(buffer->batch.triangles);
+    free(buffer);
+}
+
+////////////////////////////////////////
+void txResetCommandBuffer(TXcommandBuffer_t* buffer)
+{
+    // The vertex cache isn't part of the
+    // snapshot, it's the buffer's own
+    struct TXvertexCache vertexCache = buffer->state.vertexCache;
+    buffer->state = *currentState;
+    buffer->state.vertexCache = vertexCache;
+    buffer->state.activeQuery.query = NULL;
+    buffer->state.recordedBatch = &buffer->batch;
+
+    buffer->batch.numTriangles = 0;
+}
+
+////////////////////////////////////////
+void txBeginCommandBuffer(TXcommandBuffer_t* buffer)
+{
+    if (isRecording("txBeginCommandBuffer"))
+        return;
+
+    TXcontext_t* context = buffer->state.context;
+    int width  = getFramebufferWidth(context);
+    int height = getFramebufferHeight(context);
+    if (buffer->batch.numTriangles && (buffer->framebufferInfo != context->framebufferInfo ||
+                                       buffer->framebufferWidth != width ||
+                                       buffer->framebufferHeight != height)) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txBeginCommandBuffer: the framebuffer changed, dropping %d recorded triangles", buffer->batch.numTriangles);
+        buffer->batch.numTriangles = 0;
+    }
+    buffer->framebufferInfo = context->framebufferInfo;
+    buffer->framebufferWidth = width;
+    buffer->framebufferHeight = height;
+
+    currentState = &buffer->state;
+}
+
+////////////////////////////////////////
+void txEndCommandBuffer()
+{
+    if (!currentState->recordedBatch) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txEndCommandBuffer: no command buffer is being recorded");
+        return;
+    }
+    currentState = &currentState->context->state;
+}
+
+////////////////////////////////////////
+void txSubmitCommandBuffers(TXcommandBuffer_t* buffers[], int numBuffers)
+{
+    if (isRecording("txSubmitCommandBuffers"))
+        return;
+
+    TXcontext_t* context = currentState->context;
+    int width  = getFramebufferWidth(context);
+    int height = getFramebufferHeight(context);
+    bool defersTriangles = context->tiler.enabled || context->visibilityBuffer.enabled || context->renderThread.enabled;
+    for (int i = 0; i < numBuffers; ++i) {
+        struct TXtriangleBatch* recorded = &buffers[i]->batch;
+        if (buffers[i]->state.context != context) {
+            txOutputMessage(TX_WARNING, "[CursedGL] txSubmitCommandBuffers: skipping a command buffer recorded for another context");
+            continue;
+        }
+
+        // Bounding boxes and the hierarchical
+        // depth buffer are those of the framebuffer
+        // the buffer was recorded for
+        if (recorded->numTriangles && (buffers[i]->framebufferInfo != context->framebufferInfo ||
+                                       buffers[i]->framebufferWidth != width ||
+                                       buffers[i]->framebufferHeight != height)) {
+            txOutputMessage(TX_WARNING, "[CursedGL] txSubmitCommandBuffers: skipping a command buffer recorded for another framebuffer");
+            continue;
+        }
+
+        // The visibility buffer may have been
+        // turned on or off since recording
+        for (int j = 0; j < recorded->numTriangles; ++j)
+            reselectBlockRasterizer(&recorded->triangles[j], context->visibilityBuffer.enabled);
+
+        if (!defersTriangles) {
+            for (int j = 0; j < recorded->numTriangles; ++j)
+                rasterizeTriangle(&recorded->triangles[j], 0, 0, width - 1, height - 1);
+        } else if (reserveTriangles(&context->tiler.batch, recorded->numTriangles)) {
+            // Ids are relative to the batch
+            // the triangles end up in
+            for (int j = 0; j < recorded->numTriangles; ++j) {
+                struct TXrasterTriangle* rt = &context->tiler.batch.triangles[context->tiler.batch.numTriangles];
+                *rt = recorded->triangles[j];
+                rt->id = (unsigned)++context->tiler.batch.numTriangles;
+            }
+        } else {
+            txOutputMessage(TX_ERROR, "[CursedGL] txSubmitCommandBuffers: out of memory, dropping %d triangles", recorded->numTriangles);
+        }
+        recorded->numTriangles = 0;
+    }
+}
+
+////////////////////////////////////////
+/// Sets up a triangle whose vertices are
+/// inside the guard band and either records
+/// it into a command buffer, defers it until
+/// txFlush or rasterizes it right away
+////////////////////////////////////////
+static void renderTriangle(struct TXdrawState* state,
+                           struct TXshadedVertex* v0,
+                           struct TXshadedVertex* v1,
+                           struct TXshadedVertex* v2)
+{
+    // Command buffers are only read by the
+    // thread that records them
+    TXcontext_t* context = state->context;
+    struct TXtriangleBatch* batch = currentState->recordedBatch;
+    if (!batch && (context->tiler.enabled || context->visibilityBuffer.enabled || context->renderThread.enabled))
+        batch = &context->tiler.batch;
+
+    if (batch) {
+        if (!reserveTriangles(batch, 1)) {
+            txOutputMessage(TX_ERROR, "[CursedGL] renderTriangle: out of memory, dropping triangle");
+            return;
+        }
+        struct TXrasterTriangle* rt = &batch->triangles[batch->numTriangles];
+        if (setupTriangle(rt, state, v0, v1, v2))
+            rt->id = (unsigned)++batch->numTriangles;
+    }
+    else {
+        struct TXrasterTriangle rt;
+        if (setupTriangle(&rt, state, v0, v1, v2))
+            rasterizeTriangle(&rt, 0, 0, state->framebufferWidth - 1, state->framebufferHeight - 1);
+    }
+}
+
+////////////////////////////////////////
+/// Fetches the state the vertex shader
+/// and the rasterizer read during a draw call.
+///
+/// State that affects rasterization is captured
+/// here, so that in tiled mode (see
+/// txEnableTiledRendering) triangles are
+/// rendered the same way no matter when the
+/// tiles are actually processed
+////////////////////////////////////////
+static void beginDraw(struct TXdrawState* state, enum TXvertexInfo vertexInfo)
+{
+    TXcontext_t* context = currentState->context;
+    state->context = context;
+    state->framebufferWidth  = getFramebufferWidth(context);
+    state->framebufferHeight = getFramebufferHeight(context);
+
+    state->vertexInfo = vertexInfo;
+    state->modelViewMatrix = txGetModelViewMatrix();
+    state->projectionMatrix = txGetProjectionMatrix();
+    state->normalMatrix = txGetNormalMatrix();
+
+    // The view frustum's left, right, bottom
+    // and top planes are pushed out to the guard band
+    state->guardBand = getEffectiveGuardBand(state->framebufferWidth, state->framebufferHeight);
+
+    state->shadeModel = currentState->shadeModel;
+    txVec4Copy(state->color, currentState->rasterColor);
+    // Proxies of occlusion queries only
+    // run the depth test
+    bool writesPixels = !currentState->activeQuery.query || currentState->activeQuery.mode != TX_SAMPLES_PASSED_NO_WRITE;
+    bool writesColor = currentState->colorMask && writesPixels;
+
+    state->depthTest = isDepthTestEnabled(context);
+    state->depthMask = getDepthMask(context) && writesPixels;
+    state->depthFunc = getDepthFunc(context);
+    state->framebufferInfo = context->framebufferInfo;
+    state->query = currentState->activeQuery.query;
+
+    // With the visibility buffer, the fragment
+    // shader only runs when it's resolved.
+    // Command buffers pick again when submitted
+    enum TXfragmentShader shader = writesColor ? selectFragmentShader(vertexInfo, currentState->shadeModel) : TX_FS_DEPTH_ONLY;
+    bool visibilityBuffer = context->visibilityBuffer.enabled && !currentState->recordedBatch;
+    state->rasterizeBlock = selectBlockRasterizer(visibilityBuffer && writesColor ? TX_FS_VISIBILITY : shader,
+                                                  state->depthTest,
+                                                  state->depthFunc,
+                                                  state->depthMask);
+    state->shader = (int)shader;
+    state->resolveSpan = spanResolvers[shader];
+    state->attributePlanes = getAttributePlanes(shader);
+
+    state->cullMode = currentState->cullMode;
+    state->cullAll = false;
+    state->cullSign = 0.0f;
+    if (isCullingEnabled(context)) {
+        float frontSign = currentState->windOrder == TX_CCW ? 1.0f : -1.0f;
+        switch (currentState->cullFace) {
+            case TX_NONE:
+                break;
+            case TX_FRONT:
+                state->cullSign = -frontSign;
+                break;
+            case TX_BACK:
+                state->cullSign = frontSign;
+                break;
+            case TX_FRONT_AND_BACK:
+                state->cullAll = true;
+                break;
+        }
+    }
+}
+
+////////////////////////////////////////
+/// Copies a shaded vertex into the
+/// clipper's input. View-space positions,
+/// colors and normals are all affine in
+/// clip-space, so the clipper interpolates
+/// them like any other attribute
+////////////////////////////////////////
+static void setClipperVertex(TXvec4 pos,
+                             TXvec4 obj_pos,
+                             TXvec4 attr0,
+                             TXvec4 attr1,
+                             TXvec4 attr2,
+                             struct TXshadedVertex* sv)
+{
+    txVec4Copy(pos, sv->clipPos);
+    txVec4Copy(obj_pos, sv->viewPos);
+    txVec4Copy(attr0, sv->color);
+    txVec4Copy(attr1, sv->normal);
+    txVec4Zero(attr2);
+}
+
+////////////////////////////////////////
+/// Turns a vertex produced by the clipper
+/// back into a shaded vertex
+////////////////////////////////////////
+static void getClippedVertex(struct TXshadedVertex* sv,
+                             const struct TXdrawState* state,
+                             TXvec4 pos,
+                             TXvec4 obj_pos,
+                             TXvec4 attr0,
+                             TXvec4 attr1)
+{
+    txVec4Copy(sv->clipPos, pos);
+    txVec4Copy(sv->viewPos, obj_pos);
+    txVec4Copy(sv->color, attr0);
+    txVec4Copy(sv->normal, attr1);
+    sv->outcode = 0;
+    finishVertex(sv, state);
+}
+
+////////////////////////////////////////
+/// Returns true if screen-space face culling
+/// discards a triangle whose orientation is
+/// positive for counter-clockwise triangles
+/// and negative for clockwise ones
+////////////////////////////////////////
+TX_FORCE_INLINE bool isFaceCulled(const struct TXdrawState* state, float orientation)
+{
+    return state->cullAll || orientation * state->cullSign < 0.0f;
+}
+
+////////////////////////////////////////
+/// Orientation (see isFaceCulled) of a
+/// triangle whose vertices are all inside
+/// the guard band. It's twice the area of
+/// the triangle in window coordinates, which
+/// is negated as y points down there
+////////////////////////////////////////
+TX_FORCE_INLINE float getWindowOrientation(const struct TXshadedVertex* v0,
+                                           const struct TXshadedVertex* v1,
+                                           const struct TXshadedVertex* v2)
+{
+    return (v2->windowPos[0] - v0->windowPos[0]) * (v1->windowPos[1] - v0->windowPos[1]) -
+           (v1->windowPos[0] - v0->windowPos[0]) * (v2->windowPos[1] - v0->windowPos[1]);
+}
+
+////////////////////////////////////////
+/// Orientation (see isFaceCulled) of any
+/// triangle, including the ones that cross
+/// w = 0 and thus have no window coordinates.
+///
+/// It's the determinant of the clip-space
+/// (x, y, w) of the vertices, which is the
+/// area of the projected triangle times
+/// w0 * w1 * w2, and whose sign tells which
+/// side of the triangle the eye is on
+////////////////////////////////////////
+TX_FORCE_INLINE float getClipOrientation(const struct TXshadedVertex* v0,
+                                         const struct TXshadedVertex* v1,
+                                         const struct TXshadedVertex* v2)
+{
+    const float* a = v0->clipPos;
+    const float* b = v1->clipPos;
+    const float* c = v2->clipPos;
+    return a[0] * (b[1] * c[3] - c[1] * b[3]) -
+           a[1] * (b[0] * c[3] - c[0] * b[3]) +
+           a[3] * (b[0] * c[1] - c[0] * b[1]);
+}
+
+////////////////////////////////////////
+/// Primitive assembly: culls, clips and
+/// renders the triangle made of the given
+/// shaded vertices
+////////////////////////////////////////
+static void assembleTriangle(struct TXdrawState* state,
+                             struct TXshadedVertex* v0,
+                             struct TXshadedVertex* v1,
+                             struct TXshadedVertex* v2)
+{
+    bool cullInScreenSpace = state->cullMode == TX_CULL_IN_SCREEN_SPACE;
+    if (!cullInScreenSpace && txShouldCullFace(v0->viewPos, v1->viewPos, v2->viewPos))
+        return;
+
+    // All vertices are outside of the same plane
+    if (v0->outcode & v1->outcode & v2->outcode)
+        return;
+
+    // Nothing crosses the guard band,
+    // so there's nothing to clip
+    unsigned planes = v0->outcode | v1->outcode | v2->outcode;
+    if (!planes) {
+        if (cullInScreenSpace && isFaceCulled(state, getWindowOrientation(v0, v1, v2)))
+            return;
+        renderTriangle(state, v0, v1, v2);
+        return;
+    }
+
+    // Clipping preserves the orientation, so
+    // back-faces are culled before they're clipped
+    if (cullInScreenSpace && isFaceCulled(state, getClipOrientation(v0, v1, v2)))
+        return;
+
+    // Allocate enough memory for max
+    // possible number of triangles
+    TXtriangle_t triangles[TX_MAX_CLIPPED_TRIANGLES];
+    setClipperVertex(triangles[0].v0_pos, triangles[0].v0_obj_pos, triangles[0].v0_attr0, triangles[0].v0_attr1, triangles[0].v0_attr2, v0);
+    setClipperVertex(triangles[0].v1_pos, triangles[0].v1_obj_pos, triangles[0].v1_attr0, triangles[0].v1_attr1, triangles[0].v1_attr2, v1);
+    setClipperVertex(triangles[0].v2_pos, triangles[0].v2_obj_pos, triangles[0].v2_attr0, triangles[0].v2_attr1, triangles[0].v2_attr2, v2);
+
+    int numTriangles = txClipTriangle(triangles, planes, state->guardBand);
+    for (int i = 0; i < numTriangles; ++i) {
+        struct TXshadedVertex clipped[3];
+        getClippedVertex(&clipped[0], state, triangles[i].v0_pos, triangles[i].v0_obj_pos, triangles[i].v0_attr0, triangles[i].v0_attr1);
+        getClippedVertex(&clipped[1], state, triangles[i].v1_pos, triangles[i].v1_obj_pos, triangles[i].v1_attr0, triangles[i].v1_attr1);
+        getClippedVertex(&clipped[2], state, triangles[i].v2_pos, triangles[i].v2_obj_pos, triangles[i].v2_attr0, triangles[i].v2_attr1);
+        renderTriangle(state, &clipped[0], &clipped[1], &clipped[2]);
+    }
+}
+
+////////////////////////////////////////
+/// Makes room for numVertices shaded vertices
+/// and invalidates the ones shaded by previous
+/// draw calls. Returns false if out of memory
+////////////////////////////////////////
+static bool beginVertexCache(int numVertices)
+{
+    struct TXvertexCache* cache = &currentState->vertexCache;
+    if (numVertices > cache->maxVertices) {
+        int maxVertices = cache->maxVertices ? cache->maxVertices : 1024;
+        while (maxVertices < numVertices)
+            maxVertices *= 2;
+
+        unsigned* stamps = (unsigned*)realloc(cache->stamps, (unsigned)maxVertices * sizeof(unsigned));
+        if (!stamps)
+            return false;
+        cache->stamps = stamps;
+
+        struct TXshadedVertex* vertices = (struct TXshadedVertex*)realloc(cache->vertices,
+                                                                           (unsigned)maxVertices * sizeof(struct TXshadedVertex));
+        if (!vertices)
+            return false;
+        cache->vertices = vertices;
+
+        memset(&stamps[cache->maxVertices], 0, (unsigned)(maxVertices - cache->maxVertices) * sizeof(unsigned));
+        cache->maxVertices = maxVertices;
+    }
+
+    // Stamp 0 marks slots that were never used
+    if (!++cache->stamp) {
+        memset(cache->stamps, 0, (unsigned)cache->maxVertices * sizeof(unsigned));
+        cache->stamp = 1;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+/// Returns the shaded vertex of the vertex
+/// whose attributes are in vertex[] and whose
+/// index is index, running the vertex shader
+/// only if it hasn't run on that vertex yet
+/// during this draw call
+////////////////////////////////////////
+TX_FORCE_INLINE struct TXshadedVertex* fetchShadedVertex(struct TXvertexCache* cache,
+                                                         TXvec4 vertex[],
+                                                         unsigned index,
+                                                         const struct TXdrawState* state)
+{
+    struct TXshadedVertex* sv = &cache->vertices[index];
+    if (cache->stamps[index] != cache->stamp) {
+        runVertexShader(sv, vertex, state);
+        cache->stamps[index] = cache->stamp;
+    }
+    return sv;
+}
+
+////////////////////////////////////////
+/// Runs the vertex shader on all vertices
+/// of a draw call. Returns NULL if out of memory
+////////////////////////////////////////
+static struct TXshadedVertex* shadeVertices(TXvec4* vertices[],
+                                            int numVertices,
+                                            const struct TXdrawState* state,
+                                            const char* caller)
+{
+    if (!beginVertexCache(numVertices)) {
+        txOutputMessage(TX_ERROR, "[CursedGL] %s: out of memory while shading %d vertices", caller, numVertices);
+        return NULL;
+    }
+    struct TXshadedVertex* shaded = currentState->vertexCache.vertices;
+    for (int i = 0; i < numVertices; ++i)
+        runVertexShader(&shaded[i], vertices[i], state);
+    return shaded;
+}
+
+////////////////////////////////////////
+/// Records vertices into the display list
+/// being compiled and returns the index
+/// the first one was given
+////////////////////////////////////////
+static unsigned recordVertices(enum TXvertexInfo vertexInfo,
+                               TXvec4* vertices[],
+                               int numVertices)
+{
+    unsigned first = 0;
+    for (int i = 0; i < numVertices; ++i) {
+        unsigned index = txRecordVertex(vertexInfo, vertices[i]);
+        if (!i)
+            first = index;
+    }
+    return first;
+}
+
+////////////////////////////////////////
+void txDrawTriangle(TXvec4 v0[],
+                    TXvec4 v1[],
+                    TXvec4 v2[],
+                    enum TXvertexInfo vertexInfo)
+{
+    if (txIsCompilingList()) {
+        TXvec4* recorded[3] = { v0, v1, v2 };
+        unsigned first = recordVertices(vertexInfo, recorded, 3);
+        txRecordTriangle(first, first + 1, first + 2);
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    struct TXshadedVertex vertices[3];
+    runVertexShader(&vertices[0], v0, &state);
+    runVertexShader(&vertices[1], v1, &state);
+    runVertexShader(&vertices[2], v2, &state);
+
+    assembleTriangle(&state, &vertices[0], &vertices[1], &vertices[2]);
+}
+
+////////////////////////////////////////
+void txDrawQuad(TXvec4 v0[],
+                TXvec4 v1[],
+                TXvec4 v2[],
+                TXvec4 v3[],
+                enum TXvertexInfo vertexInfo)
+{
+    if (txIsCompilingList()) {
+        TXvec4* recorded[4] = { v0, v1, v2, v3 };
+        unsigned first = recordVertices(vertexInfo, recorded, 4);
+        txRecordTriangle(first, first + 1, first + 2);
+        txRecordTriangle(first, first + 2, first + 3);
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    struct TXshadedVertex vertices[4];
+    runVertexShader(&vertices[0], v0, &state);
+    runVertexShader(&vertices[1], v1, &state);
+    runVertexShader(&vertices[2], v2, &state);
+    runVertexShader(&vertices[3], v3, &state);
+
+    assembleTriangle(&state, &vertices[0], &vertices[1], &vertices[2]);
+    assembleTriangle(&state, &vertices[0], &vertices[2], &vertices[3]);
+}
+
+////////////////////////////////////////
+void txDrawTriangleStrip(TXvec4* vertices[],
+                         int numVertices,
+                         enum TXvertexInfo vertexInfo)
+{
+    if (numVertices < 3)
+        return;
+
+    if (txIsCompilingList()) {
+        unsigned first = recordVertices(vertexInfo, vertices, numVertices);
+        for (unsigned i = first; i < first + (unsigned)numVertices - 2; ++i) {
+            if (!((i - first) % 2))
+                txRecordTriangle(i + 2, i + 1, i);
+            else
+                txRecordTriangle(i, i + 1, i + 2);
+        }
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    struct TXshadedVertex* shaded = shadeVertices(vertices, numVertices, &state, "txDrawTriangleStrip");
+    if (!shaded)
+        return;
+
+    // Every other triangle is flipped so
+    // that they all share the same winding
+    for (int i = 0; i < numVertices - 2; ++i) {
+        if (!(i % 2))
+            assembleTriangle(&state, &shaded[i + 2], &shaded[i + 1], &shaded[i]);
+        else
+            assembleTriangle(&state, &shaded[i], &shaded[i + 1], &shaded[i + 2]);
+    }
+}
+
+////////////////////////////////////////
+void txDrawTriangleFan(TXvec4* vertices[],
+                       int numVertices,
+                       enum TXvertexInfo vertexInfo)
+{
+    if (numVertices < 3)
+        return;
+
+    if (txIsCompilingList()) {
+        unsigned first = recordVertices(vertexInfo, vertices, numVertices);
+        for (unsigned i = first; i < first + (unsigned)numVertices - 2; ++i)
+            txRecordTriangle(first, i + 1, i + 2);
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    struct TXshadedVertex* shaded = shadeVertices(vertices, numVertices, &state, "txDrawTriangleFan");
+    if (!shaded)
+        return;
+
+    for (int i = 0; i < numVertices - 2; ++i)
+        assembleTriangle(&state, &shaded[0], &shaded[i + 1], &shaded[i + 2]);
+}
+
+////////////////////////////////////////
+void txDrawIndexedTriangles(TXvec4* vertices[],
+                            int numVertices,
+                            unsigned* indices,
+                            int numIndices,
+                            enum TXvertexInfo vertexInfo)
+{
+    if (numIndices < 3)
+        return;
+
+    if (txIsCompilingList()) {
+        unsigned first = recordVertices(vertexInfo, vertices, numVertices);
+        for (int i = 0; i + 2 < numIndices; i += 3) {
+            if (indices[i] < (unsigned)numVertices && indices[i + 1] < (unsigned)numVertices && indices[i + 2] < (unsigned)numVertices)
+                txRecordTriangle(first + indices[i], first + indices[i + 1], first + indices[i + 2]);
+            else if (txGetListMode() == TX_COMPILE) // Otherwise the draw below warns
+                txOutputMessage(TX_WARNING, "[CursedGL] txDrawIndexedTriangles: triangle %d references a vertex out of range", i / 3);
+        }
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    if (!beginVertexCache(numVertices)) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txDrawIndexedTriangles: out of memory while shading %d vertices", numVertices);
+        return;
+    }
+    struct TXvertexCache* cache = &currentState->vertexCache;
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    for (int i = 0; i + 2 < numIndices; i += 3) {
+        unsigned i0 = indices[i];
+        unsigned i1 = indices[i + 1];
+        unsigned i2 = indices[i + 2];
+        if (i0 >= (unsigned)numVertices || i1 >= (unsigned)numVertices || i2 >= (unsigned)numVertices) {
+            txOutputMessage(TX_WARNING, "[CursedGL] txDrawIndexedTriangles: triangle %d references a vertex out of range", i / 3);
+            continue;
+        }
+        assembleTriangle(&state,
+                         fetchShadedVertex(cache, vertices[i0], i0, &state),
+                         fetchShadedVertex(cache, vertices[i1], i1, &state),
+                         fetchShadedVertex(cache, vertices[i2], i2, &state));
+    }
+}
+
+////////////////////////////////////////
+/// Returns true if the object-space box
+/// [boundsMin, boundsMax] is entirely outside
+/// of one of the view frustum's planes
+////////////////////////////////////////
+static bool isBoxOutsideFrustum(const struct TXdrawState* state,
+                                TXvec4 boundsMin,
+                                TXvec4 boundsMax)
+{
+    unsigned outcode = ~0u;
+    for (int i = 0; i < 8; ++i) {
+        TXvec4 corner = { (i & 1) ? boundsMax[0] : boundsMin[0],
+                          (i & 2) ? boundsMax[1] : boundsMin[1],
+                          (i & 4) ? boundsMax[2] : boundsMin[2],
+                          1.0f };
+        TXvec4 viewPos, clipPos;
+        txMulMat4Vec4(viewPos, state->modelViewMatrix, corner);
+        txMulMat4Vec4(clipPos, state->projectionMatrix, viewPos);
+
+        outcode &= txComputeOutcode(clipPos, 1.0f);
+        if (!outcode)
+            return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+/// Returns false, after warning, if array
+/// isn't one of enum TXclientState
+////////////////////////////////////////
+static bool isClientState(enum TXclientState array, const char* caller)
+{
+    if ((unsigned)array >= TX_NUM_CLIENT_STATES) {
+        txOutputMessage(TX_WARNING, "[CursedGL] %s: invalid client state (%d)", caller, (int)array);
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+void txEnableClientState(enum TXclientState array)
+{
+    if (isClientState(array, "txEnableClientState"))
+        currentState->clientArrays[array].enabled = true;
+}
+
+////////////////////////////////////////
+void txDisableClientState(enum TXclientState array)
+{
+    if (isClientState(array, "txDisableClientState"))
+        currentState->clientArrays[array].enabled = false;
+}
+
+////////////////////////////////////////
+static void setClientArray(enum TXclientState array,
+                           int size,
+                           enum TXdataType type,
+                           size_t stride,
+                           const void* pointer,
+                           const char* caller)
+{
+    if (size < 1 || size > 4) {
+        txOutputMessage(TX_WARNING, "[CursedGL] %s: size (%d) must be in [1, 4]", caller, size);
+        return;
+    }
+
+    size_t componentSize;
+    switch (type) {
+        case TX_FLOAT:
+            componentSize = sizeof(float);
+            break;
+        case TX_UNSIGNED_BYTE:
+            componentSize = sizeof(unsigned char);
+            break;
+        default:
+            txOutputMessage(TX_WARNING, "[CursedGL] %s: invalid type (%d)", caller, (int)type);
+            return;
+    }
+
+    // Bytes are normalized to [0, 1],
+    // which only makes sense for colors
+    if (type == TX_UNSIGNED_BYTE && array != TX_COLOR_ARRAY) {
+        txOutputMessage(TX_WARNING, "[CursedGL] %s: only colors can be TX_UNSIGNED_BYTE", caller);
+        return;
+    }
+
+    currentState->clientArrays[array].pointer = (const unsigned char*)pointer;
+    currentState->clientArrays[array].stride = stride ? stride : (size_t)size * componentSize;
+    currentState->clientArrays[array].size = size;
+    currentState->clientArrays[array].type = type;
+}
+
+////////////////////////////////////////
+void txVertexPointer(int size, enum TXdataType type, size_t stride, const void* pointer)
+{
+    setClientArray(TX_VERTEX_ARRAY, size, type, stride, pointer, "txVertexPointer");
+}
+
+////////////////////////////////////////
+void txColorPointer(int size, enum TXdataType type, size_t stride, const void* pointer)
+{
+    setClientArray(TX_COLOR_ARRAY, size, type, stride, pointer, "txColorPointer");
+}
+
+////////////////////////////////////////
+void txNormalPointer(enum TXdataType type, size_t stride, const void* pointer)
+{
+    setClientArray(TX_NORMAL_ARRAY, 3, type, stride, pointer, "txNormalPointer");
+}
+
+////////////////////////////////////////
+void txTexCoordPointer(int size, enum TXdataType type, size_t stride, const void* pointer)
+{
+    setClientArray(TX_TEXCOORD_ARRAY, size, type, stride, pointer, "txTexCoordPointer");
+}
+
+////////////////////////////////////////
+/// Returns the VAO configuration matching
+/// the enabled client-side arrays, and stores
+/// the enabled arrays in the order the vertex
+/// shader expects their attributes in arrays[].
+///
+/// Returns false if TX_VERTEX_ARRAY is disabled
+////////////////////////////////////////
+static bool getClientVertexInfo(enum TXvertexInfo* vertexInfo,
+                                struct TXclientArray* arrays[4],
+                                int* numArrays)
+{
+    if (!currentState->clientArrays[TX_VERTEX_ARRAY].enabled)
+        return false;
+
+    bool color    = currentState->clientArrays[TX_COLOR_ARRAY].enabled;
+    bool normal   = currentState->clientArrays[TX_NORMAL_ARRAY].enabled;
+    bool texcoord = currentState->clientArrays[TX_TEXCOORD_ARRAY].enabled;
+
+    if (color && normal && texcoord)
+        *vertexInfo = TX_POSITION_COLOR_NORMAL_TEXCOORD;
+    else if (color && normal)
+        *vertexInfo = TX_POSITION_COLOR_NORMAL;
+    else if (color && texcoord)
+        *vertexInfo = TX_POSITION_COLOR_TEXCOORD;
+    else if (normal && texcoord)
+        *vertexInfo = TX_POSITION_NORMAL_TEXCOORD;
+    else if (color)
+        *vertexInfo = TX_POSITION_COLOR;
+    else if (normal)
+        *vertexInfo = TX_POSITION_NORMAL;
+    else if (texcoord)
+        *vertexInfo = TX_POSITION_TEXCOORD;
+    else
+        *vertexInfo = TX_POSITION;
+
+    *numArrays = 0;
+    arrays[(*numArrays)++] = &currentState->clientArrays[TX_VERTEX_ARRAY];
+    if (color)
+        arrays[(*numArrays)++] = &currentState->clientArrays[TX_COLOR_ARRAY];
+    if (normal)
+        arrays[(*numArrays)++] = &currentState->clientArrays[TX_NORMAL_ARRAY];
+    if (texcoord)
+        arrays[(*numArrays)++] = &currentState->clientArrays[TX_TEXCOORD_ARRAY];
+    return true;
+}
+
+////////////////////////////////////////
+/// Reads the attributes of vertex index
+/// straight from the client-side arrays.
+/// Missing components default to (0, 0, 0, w),
+/// where w is 1 for every attribute
+/// but normals
+////////////////////////////////////////
+TX_FORCE_INLINE void fetchClientVertex(TXvec4 vertex[],
+                                       struct TXclientArray* arrays[],
+                                       int numArrays,
+                                       unsigned index)
+{
+    const struct TXclientArray* normalArray = &currentState->clientArrays[TX_NORMAL_ARRAY];
+    for (int i = 0; i < numArrays; ++i) {
+        const struct TXclientArray* array = arrays[i];
+        const unsigned char* src = array->pointer + index * array->stride;
+
+        txVec4Set(vertex[i], 0.0f, 0.0f, 0.0f, array == normalArray ? 0.0f : 1.0f);
+        switch (array->type) {
+            case TX_FLOAT:
+                memcpy(vertex[i], src, (size_t)array->size * sizeof(float));
+                break;
+            case TX_UNSIGNED_BYTE:
+                for (int k = 0; k < array->size; ++k)
+                    vertex[i][k] = (float)src[k] / 255.0f;
+                break;
+        }
+    }
+}
+
+////////////////////////////////////////
+void txDrawArrays(int first, int count)
+{
+    enum TXvertexInfo vertexInfo;
+    struct TXclientArray* arrays[4];
+    int numArrays;
+    if (!getClientVertexInfo(&vertexInfo, arrays, &numArrays)) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txDrawArrays: TX_VERTEX_ARRAY is disabled");
+        return;
+    }
+    if (first < 0 || count < 3)
+        return;
+    count -= count % 3;
+
+    if (txIsCompilingList()) {
+        for (int i = first; i < first + count; i += 3) {
+            unsigned recorded[3];
+            for (int j = 0; j < 3; ++j) {
+                TXvec4 vertex[4];
+                fetchClientVertex(vertex, arrays, numArrays, (unsigned)(i + j));
+                recorded[j] = txRecordVertex(vertexInfo, vertex);
+            }
+            txRecordTriangle(recorded[0], recorded[1], recorded[2]);
+        }
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    for (int i = first; i < first + count; i += 3) {
+        struct TXshadedVertex vertices[3];
+        for (int j = 0; j < 3; ++j) {
+            TXvec4 vertex[4];
+            fetchClientVertex(vertex, arrays, numArrays, (unsigned)(i + j));
+            runVertexShader(&vertices[j], vertex, &state);
+        }
+        assembleTriangle(&state, &vertices[0], &vertices[1], &vertices[2]);
+    }
+}
+
+////////////////////////////////////////
+void txDrawElements(unsigned* indices, int count)
+{
+    enum TXvertexInfo vertexInfo;
+    struct TXclientArray* arrays[4];
+    int numArrays;
+    if (!getClientVertexInfo(&vertexInfo, arrays, &numArrays)) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txDrawElements: TX_VERTEX_ARRAY is disabled");
+        return;
+    }
+    count -= count % 3;
+    if (count < 3)
+        return;
+
+    unsigned maxIndex = 0;
+    for (int i = 0; i < count; ++i)
+        if (indices[i] > maxIndex)
+            maxIndex = indices[i];
+
+    // The vertex cache holds at most INT_MAX vertices
+    if (maxIndex >= (unsigned)INT_MAX) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txDrawElements: index %u is out of range", maxIndex);
+        return;
+    }
+    int numVertices = (int)maxIndex + 1;
+
+    if (txIsCompilingList()) {
+        unsigned firstRecorded = 0;
+        for (unsigned i = 0; i <= maxIndex; ++i) {
+            TXvec4 vertex[4];
+            fetchClientVertex(vertex, arrays, numArrays, i);
+            unsigned index = txRecordVertex(vertexInfo, vertex);
+            if (!i)
+                firstRecorded = index;
+        }
+        for (int i = 0; i < count; i += 3)
+            txRecordTriangle(firstRecorded + indices[i], firstRecorded + indices[i + 1], firstRecorded + indices[i + 2]);
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    if (!beginVertexCache(numVertices)) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txDrawElements: out of memory while shading %d vertices", numVertices);
+        return;
+    }
+    struct TXvertexCache* cache = &currentState->vertexCache;
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexInfo);
+
+    for (int i = 0; i < count; i += 3) {
+        struct TXshadedVertex* vertices[3];
+        for (int j = 0; j < 3; ++j) {
+            unsigned index = indices[i + j];
+            vertices[j] = &cache->vertices[index];
+            if (cache->stamps[index] != cache->stamp) {
+                TXvec4 vertex[4];
+                fetchClientVertex(vertex, arrays, numArrays, index);
+                vertices[j] = fetchShadedVertex(cache, vertex, index, &state);
+            }
+        }
+        assembleTriangle(&state, vertices[0], vertices[1], vertices[2]);
+    }
+}
+
+////////////////////////////////////////
+void txDrawVertexBuffer(TXvertexBuffer_t* vertexBuffer,
+                        TXindexBuffer_t* indexBuffer)
+{
+    int numVertices = vertexBuffer->numVertices;
+    int numAttributes = vertexBuffer->numAttributes;
+    int numIndices = indexBuffer ? indexBuffer->numIndices : numVertices - numVertices % 3;
+    if (numIndices < 3)
+        return;
+
+    if (indexBuffer && indexBuffer->maxIndex >= (unsigned)numVertices) {
+        txOutputMessage(TX_WARNING, "[CursedGL] txDrawVertexBuffer: index buffer references vertex %u of %d", indexBuffer->maxIndex, numVertices);
+        return;
+    }
+
+    if (txIsCompilingList()) {
+        unsigned first = 0;
+        for (int i = 0; i < numVertices; ++i) {
+            unsigned index = txRecordVertex(vertexBuffer->vertexInfo, &vertexBuffer->data[i * numAttributes]);
+            if (!i)
+                first = index;
+        }
+        for (int i = 0; i < numIndices; i += 3) {
+            if (indexBuffer)
+                txRecordTriangle(first + indexBuffer->indices[i], first + indexBuffer->indices[i + 1], first + indexBuffer->indices[i + 2]);
+            else
+                txRecordTriangle(first + (unsigned)i, first + (unsigned)i + 1, first + (unsigned)i + 2);
+        }
+        if (txGetListMode() == TX_COMPILE)
+            return;
+    }
+
+    struct TXdrawState state;
+    beginDraw(&state, vertexBuffer->vertexInfo);
+
+    if (isBoxOutsideFrustum(&state, vertexBuffer->boundsMin, vertexBuffer->boundsMax))
+        return;
+
+    // Without indices no vertex is shared,
+    // so there's nothing worth caching
+    if (!indexBuffer) {
+        for (int i = 0; i < numIndices; i += 3) {
+            struct TXshadedVertex vertices[3];
+            runVertexShader(&vertices[0], &vertexBuffer->data[(i + 0) * numAttributes], &state);
+            runVertexShader(&vertices[1], &vertexBuffer->data[(i + 1) * numAttributes], &state);
+            runVertexShader(&vertices[2], &vertexBuffer->data[(i + 2) * numAttributes], &state);
+            assembleTriangle(&state, &vertices[0], &vertices[1], &vertices[2]);
+        }
+        return;
+    }
+
+    if (!beginVertexCache(numVertices)) {
+        txOutputMessage(TX_ERROR, "[CursedGL] txDrawVertexBuffer: out of memory while shading %d vertices", numVertices);
+        return;
+    }
+    struct TXvertexCache* cache = &currentState->vertexCache;
+
+    unsigned* indices = indexBuffer->indices;
+    for (int i = 0; i < numIndices; i += 3) {
+        unsigned i0 = indices[i];
+        unsigned i1 = indices[i + 1];
+        unsigned i2 = indices[i + 2];
+        assembleTriangle(&state,
+                         fetchShadedVertex(cache, &vertexBuffer->data[i0 * (unsigned)numAttributes], i0, &state),
+                         fetchShadedVertex(cache, &vertexBuffer->data[i1 * (unsigned)numAttributes], i1, &state),
+                         fetchShadedVertex(cache, &vertexBuffer->data[i2 * (unsigned)numAttributes], i2, &state));
+    }
 }
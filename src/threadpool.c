@@ -0,0 +1,151 @@
+// Copyright (C) 2023 saccharineboi
+
+#include "threadpool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+////////////////////////////////////////
+/// Context passed to each worker so
+/// it knows its own index
+////////////////////////////////////////
+struct TXworkerInfo
+{
+    TXthreadPool_t* pool;
+    int threadIndex;
+};
+
+////////////////////////////////////////
+/// Takes jobs off the current batch until
+/// there are none left. Expects pool->mutex
+/// to be locked and returns with it locked
+////////////////////////////////////////
+static void processJobs(TXthreadPool_t* pool, int threadIndex)
+{
+    while (pool->nextJob < pool->numJobs) {
+        int job = pool->nextJob++;
+        TXjobCallback callback = pool->callback;
+        void* userData = pool->userData;
+
+        pthread_mutex_unlock(&pool->mutex);
+        callback(userData, job, threadIndex);
+        pthread_mutex_lock(&pool->mutex);
+
+        if (++pool->numJobsDone == pool->numJobs)
+            pthread_cond_signal(&pool->doneCond);
+    }
+}
+
+////////////////////////////////////////
+static void* workerMain(void* arg)
+{
+    struct TXworkerInfo* info = (struct TXworkerInfo*)arg;
+    TXthreadPool_t* pool = info->pool;
+    int threadIndex = info->threadIndex;
+    free(info);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->quit) {
+        if (pool->nextJob < pool->numJobs)
+            processJobs(pool, threadIndex);
+        else
+            pthread_cond_wait(&pool->workCond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+////////////////////////////////////////
+int txGetNumCores()
+{
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    return numCores > 0 ? (int)numCores : 1;
+}
+
+////////////////////////////////////////
+bool txCreateThreadPool(TXthreadPool_t* pool, int numThreads)
+{
+    pool->threads = NULL;
+    pool->numThreads = 0;
+    pool->callback = NULL;
+    pool->userData = NULL;
+    pool->numJobs = 0;
+    pool->nextJob = 0;
+    pool->numJobsDone = 0;
+    pool->quit = false;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->workCond, NULL);
+    pthread_cond_init(&pool->doneCond, NULL);
+
+    if (numThreads <= 0)
+        return true;
+
+    pool->threads = (pthread_t*)malloc((unsigned)numThreads * sizeof(pthread_t));
+    if (!pool->threads) {
+        txDestroyThreadPool(pool);
+        return false;
+    }
+
+    for (int i = 0; i < numThreads; ++i) {
+        struct TXworkerInfo* info = (struct TXworkerInfo*)malloc(sizeof(struct TXworkerInfo));
+        if (!info) {
+            txDestroyThreadPool(pool);
+            return false;
+        }
+        info->pool = pool;
+        info->threadIndex = i + 1;
+
+        if (pthread_create(&pool->threads[i], NULL, workerMain, info)) {
+            free(info);
+            txDestroyThreadPool(pool);
+            return false;
+        }
+        ++pool->numThreads;
+    }
+    return true;
+}
+
+////////////////////////////////////////
+void txRunJobs(TXthreadPool_t* pool, TXjobCallback callback, void* userData, int numJobs)
+{
+    if (numJobs <= 0)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->callback = callback;
+    pool->userData = userData;
+    pool->numJobs = numJobs;
+    pool->nextJob = 0;
+    pool->numJobsDone = 0;
+    pthread_cond_broadcast(&pool->workCond);
+
+    processJobs(pool, 0);
+    while (pool->numJobsDone < pool->numJobs)
+        pthread_cond_wait(&pool->doneCond, &pool->mutex);
+
+    pool->numJobs = 0;
+    pool->nextJob = 0;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+////////////////////////////////////////
+void txDestroyThreadPool(TXthreadPool_t* pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->workCond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->numThreads; ++i)
+        pthread_join(pool->threads[i], NULL);
+
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->numThreads = 0;
+
+    pthread_cond_destroy(&pool->doneCond);
+    pthread_cond_destroy(&pool->workCond);
+    pthread_mutex_destroy(&pool->mutex);
+}
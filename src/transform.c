@@ -3,6 +3,10 @@
 #include "transform.h"
 #include <unistd.h>
 
+#if defined(__SSE__)
+    #include <xmmintrin.h>
+#endif
+
 ////////////////////////////////////////
 /// See https://www.gabrielgambetta.com/computer-graphics-from-scratch/11-clipping.html
 /// to understand how clipping algorithm works
@@ -292,6 +296,206 @@ int txClipTriangleAgainstPlane(TXtriangle_t* tri0_out,
     return 0;
 }
 
+////////////////////////////////////////
+void txTransformVertices(TXvec4* dst, TXmat4 mat, TXvec4* src, int numVertices)
+{
+#if defined(__SSE__)
+    // Columns of mat stay in registers, each vertex
+    // costs 4 broadcasts, 4 multiplies and 3 adds
+    __m128 col0 = _mm_loadu_ps(&mat[0]);
+    __m128 col1 = _mm_loadu_ps(&mat[4]);
+    __m128 col2 = _mm_loadu_ps(&mat[8]);
+    __m128 col3 = _mm_loadu_ps(&mat[12]);
+
+    for (int i = 0; i < numVertices; ++i) {
+        __m128 res = _mm_add_ps(_mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(src[i][0])),
+                                           _mm_mul_ps(col1, _mm_set1_ps(src[i][1]))),
+                                _mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(src[i][2])),
+                                           _mm_mul_ps(col3, _mm_set1_ps(src[i][3]))));
+        _mm_storeu_ps(dst[i], res);
+    }
+#else
+    for (int i = 0; i < numVertices; ++i)
+        txMulMat4Vec4(dst[i], mat, src[i]);
+#endif
+}
+
+////////////////////////////////////////
+/// A vertex of the polygon that's being
+/// clipped by txClipTriangle
+////////////////////////////////////////
+struct TXclipVertex {
+    TXvec4 pos;
+    TXvec4 obj_pos;
+    TXvec4 attr0;
+    TXvec4 attr1;
+    TXvec4 attr2;
+};
+
+////////////////////////////////////////
+/// Signed distance (scaled by some positive
+/// number) of a clip-space position to the given
+/// plane. Non-negative means inside
+////////////////////////////////////////
+static float distanceToClipPlane(TXvec4 pos, unsigned plane, float guardBand)
+{
+    switch (plane) {
+        case TX_CLIP_LEFT:
+            return guardBand * pos[3] + pos[0];
+        case TX_CLIP_RIGHT:
+            return guardBand * pos[3] - pos[0];
+        case TX_CLIP_BOTTOM:
+            return guardBand * pos[3] + pos[1];
+        case TX_CLIP_TOP:
+            return guardBand * pos[3] - pos[1];
+        case TX_CLIP_NEAR:
+            return pos[3] + pos[2];
+        case TX_CLIP_FAR:
+            return pos[3] - pos[2];
+    }
+    return 0.0f;
+}
+
+////////////////////////////////////////
+static void lerpClipVertex(struct TXclipVertex* res,
+                           struct TXclipVertex* v0,
+                           struct TXclipVertex* v1,
+                           float t)
+{
+    txVec4Lerp(res->pos, v0->pos, v1->pos, t);
+    txVec4Lerp(res->obj_pos, v0->obj_pos, v1->obj_pos, t);
+    txVec4Lerp(res->attr0, v0->attr0, v1->attr0, t);
+    txVec4Lerp(res->attr1, v0->attr1, v1->attr1, t);
+    txVec4Lerp(res->attr2, v0->attr2, v1->attr2, t);
+}
+
+////////////////////////////////////////
+/// See https://en.wikipedia.org/wiki/Sutherland%E2%80%93Hodgman_algorithm
+/// and Blinn & Newell's "Clipping Using Homogeneous Coordinates"
+////////////////////////////////////////
+int txClipTriangle(TXtriangle_t triangles[], unsigned planes, float guardBand)
+{
+    struct TXclipVertex buffers[2][3 + TX_NUM_CLIP_PLANES];
+    struct TXclipVertex* in  = buffers[0];
+    struct TXclipVertex* out = buffers[1];
+
+    TXtriangle_t* tri = &triangles[0];
+
+    txVec4Copy(in[0].pos, tri->v0_pos);
+    txVec4Copy(in[1].pos, tri->v1_pos);
+    txVec4Copy(in[2].pos, tri->v2_pos);
+
+    txVec4Copy(in[0].obj_pos, tri->v0_obj_pos);
+    txVec4Copy(in[1].obj_pos, tri->v1_obj_pos);
+    txVec4Copy(in[2].obj_pos, tri->v2_obj_pos);
+
+    txVec4Copy(in[0].attr0, tri->v0_attr0);
+    txVec4Copy(in[1].attr0, tri->v1_attr0);
+    txVec4Copy(in[2].attr0, tri->v2_attr0);
+
+    txVec4Copy(in[0].attr1, tri->v0_attr1);
+    txVec4Copy(in[1].attr1, tri->v1_attr1);
+    txVec4Copy(in[2].attr1, tri->v2_attr1);
+
+    txVec4Copy(in[0].attr2, tri->v0_attr2);
+    txVec4Copy(in[1].attr2, tri->v1_attr2);
+    txVec4Copy(in[2].attr2, tri->v2_attr2);
+
+    int numVertices = 3;
+    for (unsigned plane = 1; plane <= TX_CLIP_FAR; plane <<= 1) {
+        if (!(planes & plane))
+            continue;
+
+        int numOutVertices = 0;
+        for (int i = 0; i < numVertices; ++i) {
+            struct TXclipVertex* v0 = &in[i];
+            struct TXclipVertex* v1 = &in[(i + 1) % numVertices];
+
+            float d0 = distanceToClipPlane(v0->pos, plane, guardBand);
+            float d1 = distanceToClipPlane(v1->pos, plane, guardBand);
+
+            if (d0 >= 0.0f)
+                out[numOutVertices++] = *v0;
+
+            // The intersection is always computed from
+            // the inside vertex, so that an edge shared by
+            // two triangles is cut at exactly the same point
+            if (d0 >= 0.0f && d1 < 0.0f)
+                lerpClipVertex(&out[numOutVertices++], v0, v1, d0 / (d0 - d1));
+            else if (d0 < 0.0f && d1 >= 0.0f)
+                lerpClipVertex(&out[numOutVertices++], v1, v0, d1 / (d1 - d0));
+        }
+
+        if (numOutVertices < 3)
+            return 0;
+
+        struct TXclipVertex* tmp = in;
+        in = out;
+        out = tmp;
+        numVertices = numOutVertices;
+    }
+
+    // Triangulate the resulting convex polygon as a fan
+    for (int i = 0; i < numVertices - 2; ++i) {
+        tri = &triangles[i];
+
+        txVec4Copy(tri->v0_pos, in[0].pos);
+        txVec4Copy(tri->v1_pos, in[i + 1].pos);
+        txVec4Copy(tri->v2_pos, in[i + 2].pos);
+
+        txVec4Copy(tri->v0_obj_pos, in[0].obj_pos);
+        txVec4Copy(tri->v1_obj_pos, in[i + 1].obj_pos);
+        txVec4Copy(tri->v2_obj_pos, in[i + 2].obj_pos);
+
+        txVec4Copy(tri->v0_attr0, in[0].attr0);
+        txVec4Copy(tri->v1_attr0, in[i + 1].attr0);
+        txVec4Copy(tri->v2_attr0, in[i + 2].attr0);
+
+        txVec4Copy(tri->v0_attr1, in[0].attr1);
+        txVec4Copy(tri->v1_attr1, in[i + 1].attr1);
+        txVec4Copy(tri->v2_attr1, in[i + 2].attr1);
+
+        txVec4Copy(tri->v0_attr2, in[0].attr2);
+        txVec4Copy(tri->v1_attr2, in[i + 1].attr2);
+        txVec4Copy(tri->v2_attr2, in[i + 2].attr2);
+    }
+    return numVertices - 2;
+}
+
+////////////////////////////////////////
+/// See https://en.wikipedia.org/wiki/Liang%E2%80%93Barsky_algorithm
+////////////////////////////////////////
+bool txClipLine(TXvec4 v0, TXvec4 v1, unsigned planes, float guardBand, float* t0, float* t1)
+{
+    *t0 = 0.0f;
+    *t1 = 1.0f;
+
+    for (unsigned plane = 1; plane <= TX_CLIP_FAR; plane <<= 1) {
+        if (!(planes & plane))
+            continue;
+
+        float d0 = distanceToClipPlane(v0, plane, guardBand);
+        float d1 = distanceToClipPlane(v1, plane, guardBand);
+
+        if (d0 < 0.0f && d1 < 0.0f)
+            return false;
+        else if (d0 < 0.0f)
+            *t0 = fmaxf(*t0, d0 / (d0 - d1));
+        else if (d1 < 0.0f)
+            *t1 = fminf(*t1, d0 / (d0 - d1));
+    }
+
+    if (*t0 > *t1)
+        return false;
+
+    TXvec4 begin, end;
+    txVec4Lerp(begin, v0, v1, *t0);
+    txVec4Lerp(end, v0, v1, *t1);
+    txVec4Copy(v0, begin);
+    txVec4Copy(v1, end);
+    return true;
+}
+
 ////////////////////////////////////////
 float txIntersectPlane(TXvec4 intersection,
                        TXvec3 pointOnPlane,